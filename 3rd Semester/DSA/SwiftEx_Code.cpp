@@ -3,9 +3,28 @@
 #include <string>
 #include <climits>
 #include <iomanip>
+#include <sstream>
 #include <ctime>
 #include <cmath>
+#include <cstddef>
 #include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <csignal>
+#include <thread>
+#include <mutex>
+#include <future>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <new>
 
 using namespace std;
 
@@ -28,13 +47,151 @@ const string BOLD    = "\033[1m";
 // Speed = 10 km/sec to ensure delivery times are reasonable (under 5 mins)
 const int SIM_SPEED_KM_PER_SEC = 10;  
 const int MAX_CITIES = 100;           
-const int HASH_TABLE_SIZE = 100;      
+const int MAX_FLEET = 16;
+const int HASH_TABLE_SIZE = 128;          // Initial slot count (power of two, grows on demand)
+const int WAREHOUSE_HEAP_SIZE = 512;      // Initial warehouse heap slots (doubles on demand)
+const int HASH_MAX_LOAD_PERCENT = 80;     // Resize once the tracking table is this full
 const int MISSING_PARCEL_THRESHOLD = 300; // 300 Seconds limit for missing status
+const int BPLUS_ORDER = 32;               // Max children per archive B+ tree node
+const int ARCHIVE_PAGE_SIZE = 20;         // Rows per page in the archive browser
+const int COMMAND_LOG_CAPACITY = 16384;   // Undoable commands kept in the command ring
+const int COMMAND_TXN_CAPACITY = 64;      // Undoable transactions kept
+const int POOL_SLAB_BLOCKS = 1024;        // Nodes carved from each node-pool slab
+const int SCRATCH_CHUNK_BYTES = 16 * 1024; // Chunk size of the per-query scratch arena
+const int CLOCK_REFRESH_MS = 100;         // Refresh period of the coarse cached clock
+const int ROUTE_READER_SLOTS = 64;        // Route queries that can pin a road snapshot at once
+const int TRAFFIC_FACTOR_DEFAULT = 3000;  // Weight multiplier of plain "heavy traffic" (x3, in 1/1000)
+const int TRAFFIC_FACTOR_MAX = 30000;     // Largest multiplier a traffic feed may set (x30)
+const int TRAFFIC_FEED_MAX_RECORDS = 8192; // Road updates applied as one batch
+const int MAX_TRAVEL_PROFILES = 64;       // Distinct time-of-day travel profiles (shared by roads)
+const int MAX_PROFILE_POINTS = 1024;      // Breakpoints across all profiles
+const int ALT_LANDMARK_COUNT = 24;        // Landmarks for A* lower bounds (capped at the city count)
+
+// Rollup Retention (per source/destination city pair)
+const int ROLLUP_MINUTES = 60;            // Minute buckets kept (last hour)
+const int ROLLUP_HOURS = 7 * 24;          // Hour buckets kept (last week)
+const int ROLLUP_DAYS = 366;              // Day buckets kept (last year)
+const int AUTO_DISPATCH_BATCH_SIZE = 5;   // Max parcels sent per rolling re-dispatch wave
+
+// Auto-Dispatch Scheduler Defaults (tunable from the Admin Panel)
+const int AUTO_DISPATCH_FILL_THRESHOLD = 20;  // Parcels in one city warehouse that trigger a wave
+const int AUTO_DISPATCH_WINDOW_SEC = 30;      // Max seconds a batch may wait before a wave
+const int SCHEDULER_POLL_MS = 500;            // How often the scheduler re-checks the triggers
+const int SIM_ALERT_BACKLOG = 50;             // Simulation alerts held for the next menu refresh
+
+// Persistence (files live in the working directory)
+const char* const WAL_PATH = "swiftex.wal";
+const char* const SNAPSHOT_PATH = "swiftex.snap";
+const int WAL_GROUP_COMMIT_RECORDS = 512;                 // Dirty parcels that force an early commit
+const long long SNAPSHOT_WAL_BYTES = 64LL * 1024 * 1024;  // Log size that triggers a fresh snapshot
+const int PERSIST_BUFFER_BYTES = 1024 * 1024;             // Chunk size when a log tail is copied into a new generation
+
+// Cold Tier (finished parcels moved out of RAM into memory-mapped files)
+const char* const COLD_ROWS_PATH = "swiftex.cold";
+const char* const COLD_INDEX_PATH = "swiftex.cold.idx";
+const char* const COLD_EVENTS_PATH = "swiftex.cold.events";
+const char* const COLD_NAMES_PATH = "swiftex.cold.names";
+const char* const COLD_ROUTES_PATH = "swiftex.cold.routes";
+const int COLD_BLOCK_ROWS = 4096;          // Rows per column block in the cold file
+const int COLD_FLUSH_MIN_PARCELS = 1000;   // Archived parcels that trigger an early flush
+const int COLD_FLUSH_INTERVAL_SEC = 300;   // Otherwise flush whatever finished at this interval
+const int COLD_INDEX_LOAD_PERCENT = 70;    // Rebuild the on-disk ID index beyond this load
+
+// Server Mode (--server: counter terminals over a local socket)
+const char* const SERVER_SOCKET_PATH = "swiftex.sock";
+const int MAX_PARCEL_ID = 99999;           // Largest booking ID a counter can hand out
+const int MAX_SERVER_SHARDS = 16;          // Registration shards (by source city)
+const int SERVER_SHARD_QUEUE = 4096;       // Pending requests per shard before callers wait
+const int SERVER_SHARD_BATCH = 256;        // Requests a shard prices per wake-up
+const int SERVER_INTAKE_BATCH = 1024;      // Registrations admitted per engine lock / WAL commit
+const int SERVER_POLL_MS = 200;            // Socket poll period (shutdown latency)
 
 // ==========================================
 // 2. UTILITY CLASSES (VALIDATION & UI)
 // ==========================================
 
+// Coarse clock: a background ticker refreshes a cached Unix time every
+// CLOCK_REFRESH_MS, so timestamping is a single atomic load. Events store the
+// raw time; "HH:MM:SS" text is only produced when a history or log is printed.
+class ClockService {
+private:
+    struct Ticker {
+        mutex m;
+        condition_variable wake;
+        bool stopping;
+        thread worker;
+        Ticker() : stopping(false) {}
+    };
+
+    static atomic<long long>& cached() {
+        static atomic<long long> value(0);
+        return value;
+    }
+
+    static atomic<bool>& stopped() {
+        static atomic<bool> value(false);
+        return value;
+    }
+
+    // Never destroyed: a joinable thread must not meet a static destructor at exit
+    static Ticker& ticker() {
+        static Ticker* t = new Ticker();
+        return *t;
+    }
+
+    static void tick() {
+        Ticker& t = ticker();
+        unique_lock<mutex> lock(t.m);
+        while (!t.stopping) {
+            cached().store((long long)time(0), memory_order_relaxed);
+            t.wake.wait_for(lock, chrono::milliseconds(CLOCK_REFRESH_MS));
+        }
+    }
+
+    static void startTicker() {
+        cached().store((long long)time(0));
+        ticker().worker = thread(tick);
+    }
+
+    static void ensureStarted() {
+        static once_flag started;
+        call_once(started, startTicker);
+    }
+
+public:
+    static time_t now() {
+        if (stopped().load(memory_order_relaxed)) return time(0);
+        ensureStarted();
+        return (time_t)cached().load(memory_order_relaxed);
+    }
+
+    // Joins the ticker; later calls to now() read the system clock directly
+    static void stopTicker() {
+        ensureStarted();
+        Ticker& t = ticker();
+        stopped().store(true);
+        {
+            lock_guard<mutex> lock(t.m);
+            t.stopping = true;
+        }
+        t.wake.notify_all();
+        if (t.worker.joinable()) t.worker.join();
+    }
+
+    // "HH:MM:SS" of t; runs of events from the same second reuse the last text
+    static string timeStr(time_t t) {
+        static thread_local time_t formattedSecond = -1;
+        static thread_local char buffer[16];
+        if (t != formattedSecond) {
+            struct tm local;
+            localtime_r(&t, &local);
+            strftime(buffer, sizeof(buffer), "%H:%M:%S", &local);
+            formattedSecond = t;
+        }
+        return string(buffer);
+    }
+};
+
 class UIHelper {
 public:
     static void clearScreen() {
@@ -130,13 +287,187 @@ public:
         cin.ignore(INT_MAX, '\n');
         cin.get();
     }
-    
-    static string getCurrentTimeStr() {
-        time_t now = time(0);
-        tm *ltm = localtime(&now);
-        char buffer[80];
-        strftime(buffer, 80, "%H:%M:%S", ltm);
-        return string(buffer);
+};
+
+// --- NODE POOLS & SCRATCH ARENA ---
+// Fixed-size block pool: nodes are carved contiguously out of large slabs and
+// recycled through a free list, so list/tree/log nodes never hit the general
+// heap after warm-up. Each node type keeps one pool per thread (no locking).
+// Every slab starts with a pointer to the pool that carved it; a node freed on
+// another thread is pushed back onto its owner's lock-free return list, which
+// the owner drains when its own free list runs dry. Without that, nodes made by
+// a producer thread (the server intake) and freed by the engine would pile up
+// on the engine's free list while the producer kept carving new slabs.
+// Pools and slabs are never returned, so nodes outlive the thread that carved them;
+// a thread that exits parks its pool for the next thread (see PoolHandle).
+class FixedBlockPool {
+private:
+    struct FreeBlock { FreeBlock* next; };
+    static const size_t SLAB_HEADER = 64;   // Owner pointer, padded to keep blocks cache-line aligned
+
+    size_t blockSize;
+    size_t slabBytes;        // Power of two; slabs are aligned to it, so masking a block finds its header
+    int blocksPerSlab;
+    FreeBlock* freeList;
+    char* slabCursor;
+    int slabRemaining;
+    atomic<FreeBlock*> returned;   // Blocks freed by other threads
+    FixedBlockPool* parkedNext;    // Link while parked by an exited thread
+
+    FixedBlockPool* ownerOf(void* ptr) {
+        return *reinterpret_cast<FixedBlockPool**>((uintptr_t)ptr & ~(uintptr_t)(slabBytes - 1));
+    }
+
+public:
+    FixedBlockPool(size_t size, int perSlab)
+        : blockSize((size + 15) & ~(size_t)15), slabBytes(SLAB_HEADER), blocksPerSlab(0),
+          freeList(nullptr), slabCursor(nullptr), slabRemaining(0), returned(nullptr), parkedNext(nullptr) {
+        while (slabBytes < SLAB_HEADER + blockSize * perSlab) slabBytes *= 2;
+        blocksPerSlab = (int)((slabBytes - SLAB_HEADER) / blockSize);
+    }
+
+    void* allocate() {
+        if (!freeList && returned.load(memory_order_relaxed)) freeList = returned.exchange(nullptr, memory_order_acquire);
+        if (freeList) {
+            FreeBlock* b = freeList;
+            freeList = b->next;
+            return b;
+        }
+        if (slabRemaining == 0) {
+            char* slab = static_cast<char*>(::operator new(slabBytes, align_val_t(slabBytes)));
+            *reinterpret_cast<FixedBlockPool**>(slab) = this;
+            slabCursor = slab + SLAB_HEADER;
+            slabRemaining = blocksPerSlab;
+        }
+        void* b = slabCursor;
+        slabCursor += blockSize;
+        slabRemaining--;
+        return b;
+    }
+
+    void release(void* ptr) {
+        if (!ptr) return;
+        FreeBlock* b = static_cast<FreeBlock*>(ptr);
+        FixedBlockPool* owner = ownerOf(ptr);
+        if (owner != this) {
+            FreeBlock* head = owner->returned.load(memory_order_relaxed);
+            do {
+                b->next = head;
+            } while (!owner->returned.compare_exchange_weak(head, b, memory_order_release, memory_order_relaxed));
+            return;
+        }
+        b->next = freeList;
+        freeList = b;
+    }
+
+    static mutex& parkingLock() {
+        static mutex m;
+        return m;
+    }
+
+    // A pool parked on `parked` by an exited thread, or a fresh one
+    static FixedBlockPool* adopt(FixedBlockPool*& parked, size_t size, int perSlab) {
+        {
+            lock_guard<mutex> guard(parkingLock());
+            if (parked) {
+                FixedBlockPool* p = parked;
+                parked = p->parkedNext;
+                p->parkedNext = nullptr;
+                return p;
+            }
+        }
+        return new FixedBlockPool(size, perSlab);
+    }
+
+    static void park(FixedBlockPool*& parked, FixedBlockPool* pool) {
+        lock_guard<mutex> guard(parkingLock());
+        pool->parkedNext = parked;
+        parked = pool;
+    }
+};
+
+// A thread's pool for one node type. Server connections and shards come and go;
+// when one exits its pool (slabs, free list and any blocks still being returned
+// to it) passes to the next thread that needs that node type, so memory stays
+// bounded by the number of live threads instead of every thread ever started.
+class PoolHandle {
+private:
+    FixedBlockPool*& parked;
+    FixedBlockPool* pool;
+
+public:
+    PoolHandle(FixedBlockPool*& parkedPools, size_t size, int perSlab)
+        : parked(parkedPools), pool(FixedBlockPool::adopt(parkedPools, size, perSlab)) {}
+    ~PoolHandle() { FixedBlockPool::park(parked, pool); }
+
+    FixedBlockPool& get() { return *pool; }
+};
+
+// Bump allocator for short-lived per-query temporaries (e.g. the path stack).
+// Take a mark() before the query and rewind() to it afterwards; chunks are kept
+// and reused, so steady-state queries allocate nothing.
+class ScratchArena {
+private:
+    struct Chunk {
+        Chunk* next;
+        size_t used;
+        size_t capacity;
+    };
+    static const size_t HEADER = (sizeof(Chunk) + 15) & ~(size_t)15;
+
+    Chunk* first;
+    Chunk* current;
+
+    Chunk* newChunk(size_t capacity) {
+        Chunk* c = static_cast<Chunk*>(::operator new(HEADER + capacity));
+        c->next = nullptr;
+        c->used = 0;
+        c->capacity = capacity;
+        return c;
+    }
+
+public:
+    struct Mark {
+        Chunk* chunk;
+        size_t used;
+    };
+
+    ScratchArena() : first(nullptr), current(nullptr) {}
+
+    ~ScratchArena() {
+        while (first) {
+            Chunk* n = first->next;
+            ::operator delete(first);
+            first = n;
+        }
+    }
+
+    void* allocate(size_t bytes) {
+        bytes = (bytes + 15) & ~(size_t)15;
+        if (!current) current = first = newChunk(bytes > (size_t)SCRATCH_CHUNK_BYTES ? bytes : SCRATCH_CHUNK_BYTES);
+        while (current->used + bytes > current->capacity) {
+            if (!current->next) {
+                current->next = newChunk(bytes > (size_t)SCRATCH_CHUNK_BYTES ? bytes : SCRATCH_CHUNK_BYTES);
+            }
+            current = current->next;
+            current->used = 0;
+        }
+        void* p = reinterpret_cast<char*>(current) + HEADER + current->used;
+        current->used += bytes;
+        return p;
+    }
+
+    Mark mark() { return Mark{current, current ? current->used : 0}; }
+
+    void rewind(Mark m) {
+        current = m.chunk ? m.chunk : first;
+        if (current) current->used = m.chunk ? m.used : 0;
+    }
+
+    // One arena per thread, shared by all queries running on it
+    static ScratchArena& forThread() {
+        static thread_local ScratchArena arena;
+        return arena;
     }
 };
 
@@ -144,52 +475,414 @@ public:
 // 3. CORE DOMAIN OBJECTS
 // ==========================================
 
-struct Parcel {
+// --- PARCEL EVENT LOG ---
+// History is stored as fixed 8-byte records (time, event code, small argument)
+// in pooled 64-byte chunks, and only turned into text by displayFullDetails.
+// Recording an event is a couple of stores, plus one pool pop every
+// EVENT_CHUNK_CAPACITY events; no string is built or grown.
+enum ParcelEventCode {
+    EV_CREATED = 0,
+    EV_PICKUP_QUEUED,
+    EV_ROUTE_ASSIGNED,        // arg = route at booking time (RouteTable id)
+    EV_WAREHOUSE_SORTED,
+    EV_DISPATCHED,            // arg = rider name (NameTable id)
+    EV_AUTO_DISPATCH_FREED,
+    EV_AUTO_DISPATCH_FULL,
+    EV_AUTO_DISPATCH_WINDOW,
+    EV_UNDO_DISPATCH,
+    EV_MISSING,
+    EV_ROUTE_BLOCKED_RETURN,
+    EV_RETURNED,
+    EV_DELIVERED,
+    EV_ARCHIVED,
+    EV_UNDO_PICKUP
+};
+
+struct ParcelEvent {
+    unsigned int time;     // Unix seconds
+    unsigned short code;   // ParcelEventCode
+    unsigned short arg;
+};
+
+const int EVENT_CHUNK_CAPACITY = 7;   // 7 x 8-byte events + next pointer = one 64-byte chunk
+
+struct EventChunk {
+    EventChunk* next;
+    ParcelEvent events[EVENT_CHUNK_CAPACITY];
+
+    static FixedBlockPool& pool() {
+        static FixedBlockPool* parked = nullptr;
+        static thread_local PoolHandle p(parked, sizeof(EventChunk), POOL_SLAB_BLOCKS);
+        return p.get();
+    }
+    static void* operator new(size_t) { return pool().allocate(); }
+    static void operator delete(void* ptr) { pool().release(ptr); }
+};
+
+// Interned names referenced by parcels and event arguments (cities, riders).
+// Id 0 is reserved for "None". A full table is reported to the caller, never
+// papered over with id 0.
+class NameTable {
+private:
+    static const int CAPACITY = 65535;
+    static const int INDEX_SLOTS = 131072;   // Open-addressed name -> id index, kept at most half full
+
+    static string* names() {
+        static string table[CAPACITY] = {"None"};
+        return table;
+    }
+    static unsigned short* index() {
+        static unsigned short slots[INDEX_SLOTS]; // id + 1, 0 = empty
+        return slots;
+    }
+    static int& count() {
+        static int n = 1;
+        return n;
+    }
+    static mutex& lock() {
+        static mutex m;
+        return m;
+    }
+
+    // Index slot holding `name`, or the empty slot where it would go
+    static unsigned int slotOf(const string& name) {
+        unsigned int slot = (unsigned int)hash<string>()(name) & (INDEX_SLOTS - 1);
+        while (index()[slot] != 0 && names()[index()[slot] - 1] != name) slot = (slot + 1) & (INDEX_SLOTS - 1);
+        return slot;
+    }
+
+public:
+    // False (and id untouched) when the name is new and all CAPACITY ids are taken
+    static bool intern(const string& name, unsigned short& id) {
+        lock_guard<mutex> guard(lock());
+        unsigned int slot = slotOf(name);
+        if (index()[slot] != 0) {
+            id = index()[slot] - 1;
+            return true;
+        }
+        if (name == names()[0]) {
+            id = 0;
+            return true;
+        }
+        if (count() == CAPACITY) return false;
+        names()[count()] = name;
+        index()[slot] = (unsigned short)(count() + 1);
+        id = (unsigned short)count()++;
+        return true;
+    }
+
+    // Id of a name interned earlier (city names are interned when the map is built)
+    static unsigned short find(const string& name) {
+        lock_guard<mutex> guard(lock());
+        unsigned int slot = slotOf(name);
+        return index()[slot] ? index()[slot] - 1 : 0;
+    }
+
+    static string lookup(unsigned short id) {
+        lock_guard<mutex> guard(lock());
+        return (id < count()) ? names()[id] : "?";
+    }
+};
+
+// Routes assigned to parcels, stored as sequences of graph city ids and turned
+// into "A -> B -> C" text only for display. Identical routes share an id; id 0
+// is "not assigned". Like NameTable, a full table is reported to the caller.
+class RouteTable {
+private:
+    static const int CAPACITY = 65535;
+    static const int INDEX_SLOTS = 131072;
+
+    struct Store {
+        short* cities;               // Every route's city ids, back to back
+        int used;
+        int capacity;
+        int start[CAPACITY + 1];     // Route id -> offset in cities; start[id + 1] ends it
+        unsigned short slots[INDEX_SLOTS]; // id + 1, 0 = empty
+        unsigned short cityName[MAX_CITIES]; // NameTable id of each graph city
+        int count;
+    };
+
+    static Store* create() {
+        Store* s = new Store();
+        s->capacity = 4096;
+        s->cities = new short[s->capacity];
+        s->count = 1;   // Id 0: the empty route
+        return s;
+    }
+    static Store& store() {
+        static Store* s = create();
+        return *s;
+    }
+    static mutex& lock() {
+        static mutex m;
+        return m;
+    }
+
+    static unsigned int hashOf(const short* cities, int n) {
+        unsigned int h = 2166136261u;
+        for (int i = 0; i < n; i++) h = (h ^ (unsigned short)cities[i]) * 16777619u;
+        return h;
+    }
+
+public:
+    static void setCityName(int city, unsigned short nameId) {
+        if (city >= 0 && city < MAX_CITIES) store().cityName[city] = nameId;
+    }
+
+    static bool intern(const short* cities, int n, unsigned short& id) {
+        lock_guard<mutex> guard(lock());
+        Store& s = store();
+        if (n <= 0) {
+            id = 0;
+            return true;
+        }
+        unsigned int slot = hashOf(cities, n) & (INDEX_SLOTS - 1);
+        while (s.slots[slot] != 0) {
+            int r = s.slots[slot] - 1;
+            if (s.start[r + 1] - s.start[r] == n && memcmp(s.cities + s.start[r], cities, n * sizeof(short)) == 0) {
+                id = (unsigned short)r;
+                return true;
+            }
+            slot = (slot + 1) & (INDEX_SLOTS - 1);
+        }
+        if (s.count == CAPACITY) return false;
+        if (s.used + n > s.capacity) {
+            int grownCap = s.capacity * 2;
+            while (grownCap < s.used + n) grownCap *= 2;
+            short* grown = new short[grownCap];
+            memcpy(grown, s.cities, s.used * sizeof(short));
+            delete[] s.cities;
+            s.cities = grown;
+            s.capacity = grownCap;
+        }
+        memcpy(s.cities + s.used, cities, n * sizeof(short));
+        s.start[s.count] = s.used;
+        s.used += n;
+        s.start[s.count + 1] = s.used;
+        s.slots[slot] = (unsigned short)(s.count + 1);
+        id = (unsigned short)s.count++;
+        return true;
+    }
+
+    // Copies up to max city ids of a route; returns how many it holds
+    static int cities(unsigned short id, short* out, int max) {
+        lock_guard<mutex> guard(lock());
+        Store& s = store();
+        if (id == 0 || id >= s.count) return 0;
+        int n = min(s.start[id + 1] - s.start[id], max);
+        memcpy(out, s.cities + s.start[id], n * sizeof(short));
+        return n;
+    }
+
+    static string describe(unsigned short id) {
+        short route[MAX_CITIES];
+        int n = cities(id, route, MAX_CITIES);
+        string text;
+        for (int i = 0; i < n; i++) {
+            if (i > 0) text += " -> ";
+            text += NameTable::lookup(route[i] >= 0 && route[i] < MAX_CITIES ? store().cityName[route[i]] : 0);
+        }
+        return text;
+    }
+};
+
+// Compact status codes; Parcel::status holds one of these
+enum ParcelStatusCode {
+    ST_PICKUP = 0,
+    ST_WAREHOUSE,
+    ST_IN_TRANSIT,
+    ST_RETURNING,
+    ST_DELIVERED,
+    ST_RETURNED,
+    ST_FAILED,
+    ST_MISSING,
+    ST_COUNT
+};
+
+const string STATUS_CODE_NAMES[ST_COUNT] = {
+    "Pickup Queue", "Warehouse", "In Transit", "Returning",
+    "Delivered", "Returned to Sender", "Delivery Failed", "MISSING"
+};
+
+// Parcel timestamps are 32-bit seconds since PARCEL_EPOCH (good until 2160)
+typedef unsigned int ParcelTime;
+const time_t PARCEL_EPOCH = 1704067200; // 2024-01-01 00:00:00 UTC
+
+inline ParcelTime toParcelTime(time_t t) { return (ParcelTime)(t - PARCEL_EPOCH); }
+inline time_t fromParcelTime(ParcelTime t) { return PARCEL_EPOCH + (time_t)t; }
+
+struct Rider;
+struct ParcelNode;
+
+// Compact layout: everything the simulation tick, dispatcher and counters read
+// lives in the first 64-byte line; list/index handles and history follow in the
+// second. Names are NameTable ids, weight and cost are integer grams / paisa,
+// and the category is derived from the weight, so a parcel is 128 bytes flat.
+struct alignas(64) Parcel {
+    // ---- Hot line ----
     int id;
-    string sourceCity;
-    string destCity;
-    double weight;
-    int priorityLevel; 
-    string weightCategory; 
-    string status; 
-    double shippingCost;
-    string assignedRoute;
-    int totalDistanceKm;
-    time_t creationTime;
-    time_t lastUpdateTime;
-    time_t dispatchTime;
-    int estimatedDurationSec;
-    bool isReturning;
-    bool willFailOnPath;
-    string assignedRiderName;
-    string historyLog;
-
-    Parcel() : id(0), weight(0), priorityLevel(3) {}
-
-    Parcel(int pid, string src, string dest, double w, int p) 
-        : id(pid), sourceCity(src), destCity(dest), weight(w), priorityLevel(p),
-          status("Pickup Queue"), assignedRoute("Not Assigned"), totalDistanceKm(0),
-          estimatedDurationSec(0), isReturning(false), willFailOnPath(false), dispatchTime(0), assignedRiderName("None")
+    unsigned int weightGrams;
+    unsigned int costPaisa;
+    ParcelTime creationTime;
+    ParcelTime lastUpdateTime;
+    ParcelTime dispatchTime;
+    ParcelTime completionTime; // When the parcel was Delivered / Returned (0 while active)
+    int columnSlot;            // Row in ParcelColumnStore (-1 until registered)
+    unsigned short estimatedDurationSec;
+    unsigned short totalDistanceKm;
+    short sourceCityID;        // Graph ids (-1 until registered)
+    short destCityID;
+    unsigned short sourceNameId;  // NameTable ids
+    unsigned short destNameId;
+    unsigned short routeId;       // RouteTable id, 0 = not assigned yet
+    unsigned short riderNameId;   // 0 = none
+    unsigned short historyCount;
+    unsigned char status : 4;      // ParcelStatusCode
+    unsigned char priorityLevel : 2;
+    unsigned char isReturning : 1;
+    unsigned char willFailOnPath : 1;
+    signed char indexedStatus;     // Status list the parcel currently sits in (see ParcelIndexes)
+    signed char indexedRider;      // Fleet slot of the rider list it sits in (-1 = none)
+    bool walPending;               // Queued for the next write-ahead log commit
+    Rider* assignedRider;          // Rider currently carrying this parcel (nullptr when not in transit)
+
+    // ---- Cold line ----
+    EventChunk* historyTail;   // Chunks form a ring: historyTail->next is the oldest chunk
+
+    // Stable handles into the lists this parcel belongs to, for O(1) unlinking
+    ParcelNode* masterNode;
+    ParcelNode* pickupNode;
+    ParcelNode* transitNode;
+
+    // Secondary index memberships (see ParcelIndexes)
+    ParcelNode* statusIndexNode;
+    ParcelNode* sourceIndexNode;
+    ParcelNode* destIndexNode;
+    ParcelNode* riderIndexNode;
+
+    Parcel(int pid, const string& src, const string& dest, double w, int p)
+        : id(pid), weightGrams((unsigned int)lround(w * 1000.0)), costPaisa(0), dispatchTime(0), completionTime(0),
+          columnSlot(-1), estimatedDurationSec(0), totalDistanceKm(0), sourceCityID(-1), destCityID(-1),
+          sourceNameId(NameTable::find(src)), destNameId(NameTable::find(dest)), routeId(0), riderNameId(0),
+          historyCount(0), status(ST_PICKUP), priorityLevel(p), isReturning(0), willFailOnPath(0),
+          indexedStatus(-1), indexedRider(-1), walPending(false), assignedRider(nullptr), historyTail(nullptr),
+          masterNode(nullptr), pickupNode(nullptr), transitNode(nullptr), statusIndexNode(nullptr),
+          sourceIndexNode(nullptr), destIndexNode(nullptr), riderIndexNode(nullptr)
     {
-        creationTime = time(0);
-        lastUpdateTime = time(0);
-        
-        if (weight <= 50.0) weightCategory = "Light";
-        else if (weight <= 150.0) weightCategory = "Heavy";
-        else weightCategory = "Fragile";
+        creationTime = toParcelTime(ClockService::now());
+        lastUpdateTime = creationTime;
+
+        addToHistory(EV_CREATED);
+        addToHistory(EV_PICKUP_QUEUED);
+    }
+
+    // Empty shell filled in by crash recovery (see ParcelImage)
+    explicit Parcel(int pid)
+        : id(pid), weightGrams(0), costPaisa(0), creationTime(0), lastUpdateTime(0), dispatchTime(0), completionTime(0),
+          columnSlot(-1), estimatedDurationSec(0), totalDistanceKm(0), sourceCityID(-1), destCityID(-1),
+          sourceNameId(0), destNameId(0), routeId(0), riderNameId(0),
+          historyCount(0), status(ST_PICKUP), priorityLevel(3), isReturning(0), willFailOnPath(0),
+          indexedStatus(-1), indexedRider(-1), walPending(false), assignedRider(nullptr), historyTail(nullptr),
+          masterNode(nullptr), pickupNode(nullptr), transitNode(nullptr), statusIndexNode(nullptr),
+          sourceIndexNode(nullptr), destIndexNode(nullptr), riderIndexNode(nullptr) {}
+
+    // History chunks belong to this parcel alone
+    Parcel(const Parcel&) = delete;
+    Parcel& operator=(const Parcel&) = delete;
+
+    ~Parcel() {
+        clearHistory();
+    }
+
+    void clearHistory() {
+        if (!historyTail) return;
+        EventChunk* c = historyTail->next;
+        historyTail->next = nullptr; // Break the ring
+        while (c) {
+            EventChunk* n = c->next;
+            delete c;
+            c = n;
+        }
+        historyTail = nullptr;
+        historyCount = 0;
+    }
+
+    double weight() const { return weightGrams / 1000.0; }
+    double shippingCost() const { return costPaisa / 100.0; }
+    string sourceCity() const { return NameTable::lookup(sourceNameId); }
+    string destCity() const { return NameTable::lookup(destNameId); }
+    string assignedRoute() const { return routeId ? RouteTable::describe(routeId) : "Not Assigned"; }
+    string assignedRiderName() const { return NameTable::lookup(riderNameId); }
+
+    string weightCategory() const {
+        if (weightGrams <= 50000) return "Light";
+        if (weightGrams <= 150000) return "Heavy";
+        return "Fragile";
+    }
+
+    string statusText() const {
+        if (status == ST_WAREHOUSE) return sourceCity() + " Warehouse";
+        return STATUS_CODE_NAMES[status];
+    }
 
-        shippingCost = 0; 
+    void addToHistory(ParcelEventCode code, unsigned short arg = 0) {
+        time_t now = ClockService::now();
+        lastUpdateTime = toParcelTime(now);
+        appendEvent(ParcelEvent{(unsigned int)now, (unsigned short)code, arg});
+    }
+
+    void appendEvent(const ParcelEvent& ev) {
+        if (historyCount == USHRT_MAX) return;
+        int slot = historyCount % EVENT_CHUNK_CAPACITY;
+        if (slot == 0) {
+            EventChunk* c = new EventChunk();
+            if (historyTail) {
+                c->next = historyTail->next;
+                historyTail->next = c;
+            } else {
+                c->next = c;
+            }
+            historyTail = c;
+        }
+        historyTail->events[slot] = ev;
+        historyCount++;
+    }
 
-        addToHistory("Parcel Created at " + src + ". Category: " + weightCategory);
-        addToHistory("Placed in " + src + " Pickup Queue.");
+    string describeEvent(const ParcelEvent& e) {
+        switch (e.code) {
+            case EV_CREATED:              return "Parcel Created at " + sourceCity() + ". Category: " + weightCategory();
+            case EV_PICKUP_QUEUED:        return "Placed in " + sourceCity() + " Pickup Queue.";
+            case EV_ROUTE_ASSIGNED:       return "Route Assigned: " + (e.arg ? RouteTable::describe(e.arg) : assignedRoute());
+            case EV_WAREHOUSE_SORTED:     return "Processed from Pickup Queue. Moved to " + sourceCity() + " Warehouse Sorting.";
+            case EV_DISPATCHED:           return "Dispatched: Assigned to " + NameTable::lookup(e.arg);
+            case EV_AUTO_DISPATCH_FREED:  return "Auto-Dispatch: Sent out on freed rider capacity.";
+            case EV_AUTO_DISPATCH_FULL:   return "Auto-Dispatch: Scheduled wave (warehouse full).";
+            case EV_AUTO_DISPATCH_WINDOW: return "Auto-Dispatch: Scheduled wave (batch window expired).";
+            case EV_UNDO_DISPATCH:        return "UNDO: Dispatch reversed. Returned to Warehouse.";
+            case EV_MISSING:              return "ALERT: Parcel declared MISSING due to inactivity.";
+            case EV_ROUTE_BLOCKED_RETURN: return "FAILURE: Route Blocked. Returned to Source Warehouse.";
+            case EV_RETURNED:             return "Process Complete: Item returned to sender.";
+            case EV_DELIVERED:            return "Process Complete: Successfully Delivered.";
+            case EV_ARCHIVED:             return "Archived: Moved to Historical Record.";
+            case EV_UNDO_PICKUP:          return "UNDO: Pickup processing reversed. Back in " + sourceCity() + " Pickup Queue.";
+        }
+        return "Unknown Event";
     }
 
-    void addToHistory(string event) {
-        string timeStr = UIHelper::getCurrentTimeStr();
-        historyLog += "    [" + timeStr + "] " + event + "\n";
-        lastUpdateTime = time(0);
+    void printHistory() {
+        if (!historyTail) return;
+        int printed = 0;
+        EventChunk* c = historyTail->next;
+        while (printed < historyCount) {
+            for (int i = 0; i < EVENT_CHUNK_CAPACITY && printed < historyCount; i++, printed++) {
+                cout << "    [" << ClockService::timeStr(c->events[i].time) << "] " << describeEvent(c->events[i]) << "\n";
+            }
+            c = c->next;
+        }
     }
 
+    int getStatusCode() const { return status; }
+
     string getPriorityStr() {
         if (priorityLevel == 1) return "High";
         if (priorityLevel == 2) return "Med";
@@ -197,47 +890,51 @@ struct Parcel {
     }
     
     string getStatusColor() {
-        if (status == "Delivered") return GREEN;
-        if (status == "Delivery Failed" || status == "Returned to Sender" || status == "MISSING") return RED;
-        if (status == "In Transit") return BLUE;
-        if (status.find("Warehouse") != string::npos) return MAGENTA;
+        if (status == ST_DELIVERED) return GREEN;
+        if (status == ST_FAILED || status == ST_RETURNED || status == ST_MISSING) return RED;
+        if (status == ST_IN_TRANSIT) return BLUE;
+        if (status == ST_WAREHOUSE) return MAGENTA;
         return YELLOW;
     }
 
     void displayTableRow() {
         cout << " | " << setw(5) << id 
-             << " | " << setw(12) << sourceCity.substr(0,12) 
-             << " | " << setw(12) << destCity.substr(0,12)
-             << " | " << setw(6) << weight
+             << " | " << setw(12) << sourceCity().substr(0,12) 
+             << " | " << setw(12) << destCity().substr(0,12)
+             << " | " << setw(6) << weight()
              << " | " << setw(5) << getPriorityStr()
-             << " | " << getStatusColor() << setw(25) << status << RESET
-             << " | " << setw(8) << assignedRiderName.substr(0,8)
+             << " | " << getStatusColor() << setw(25) << statusText() << RESET
+             << " | " << setw(8) << assignedRiderName().substr(0,8)
              << " | " << endl;
     }
     
     void displayFullDetails() {
         UIHelper::printSubHeader("Parcel Details: ID #" + to_string(id));
-        cout << " Source:      " << setw(20) << sourceCity << " | Destination: " << destCity << endl;
-        cout << " Weight:      " << setw(20) << (to_string(weight) + " kg") << " | Category:    " << weightCategory << endl;
-        cout << " Priority:    " << setw(20) << getPriorityStr() << " | Status:      " << getStatusColor() << status << RESET << endl;
-        cout << " Route:       " << assignedRoute << endl;
-        cout << " Est. Time:   " << estimatedDurationSec << " sec      | Cost:        PKR " << fixed << setprecision(2) << shippingCost << endl;
-        cout << " Rider:       " << assignedRiderName << endl;
+        cout << " Source:      " << setw(20) << sourceCity() << " | Destination: " << destCity() << endl;
+        cout << " Weight:      " << setw(20) << (to_string(weight()) + " kg") << " | Category:    " << weightCategory() << endl;
+        cout << " Priority:    " << setw(20) << getPriorityStr() << " | Status:      " << getStatusColor() << statusText() << RESET << endl;
+        cout << " Route:       " << assignedRoute() << endl;
+        cout << " Est. Time:   " << estimatedDurationSec << " sec      | Cost:        PKR " << fixed << setprecision(2) << shippingCost() << endl;
+        cout << " Rider:       " << assignedRiderName() << endl;
         
-        bool isMissing = (status == "MISSING");
+        bool isMissing = (status == ST_MISSING);
         cout << " Missing?:    " << (isMissing ? (RED + "YES (Confirmed)") : (GREEN + "NO")) << RESET << endl;
         cout << endl << BOLD << " >> HISTORY TIMELINE:" << RESET << endl;
-        cout << historyLog << endl;
+        printHistory();
+        cout << endl;
         UIHelper::printLine();
     }
     
     bool isMissing() {
-        if (status == "Delivered" || status == "Delivery Failed" || status == "Returned to Sender" || status == "MISSING") return false;
-        time_t now = time(0);
-        return (difftime(now, lastUpdateTime) > MISSING_PARCEL_THRESHOLD);
+        if (status == ST_DELIVERED || status == ST_FAILED || status == ST_RETURNED || status == ST_MISSING) return false;
+        time_t now = ClockService::now();
+        return (difftime(now, fromParcelTime(lastUpdateTime)) > MISSING_PARCEL_THRESHOLD);
     }
 };
 
+static_assert(offsetof(Parcel, historyTail) <= 64, "Parcel hot fields must fit in one cache line");
+static_assert(sizeof(Parcel) == 128, "Parcel should stay two cache lines");
+
 struct Rider {
     int id;
     string name;
@@ -245,9 +942,17 @@ struct Rider {
     double maxLoadCapacity;
     double currentLoad;
     string status; // "Idle", "Busy"
+    int activeParcels;   // Parcels currently on board
+    int deliveredCount;  // Running totals fed by the analytics hook
+    double deliveredKg;
+    int fleetIndex;      // Slot in SwiftExEngine::fleet
+    unsigned short nameId; // Interned name, referenced by parcel history events
 
     Rider(int i, string n, string v, double cap)
-        : id(i), name(n), vehicleType(v), maxLoadCapacity(cap), currentLoad(0), status("Idle") {}
+        : id(i), name(n), vehicleType(v), maxLoadCapacity(cap), currentLoad(0), status("Idle"),
+          activeParcels(0), deliveredCount(0), deliveredKg(0), fleetIndex(-1), nameId(0) {
+        if (!NameTable::intern(n, nameId)) cout << RED << " [!] Name table full: rider " << n << " is recorded without a name." << RESET << endl;
+    }
         
     bool canCarry(double w) {
         return (currentLoad + w <= maxLoadCapacity);
@@ -255,11 +960,23 @@ struct Rider {
     
     void assignParcel(double w) {
         currentLoad += w;
+        activeParcels++;
         status = "Busy";
     }
+
+    // Frees capacity once a carried parcel leaves the rider (delivered, failed, undone)
+    void releaseParcel(double w) {
+        currentLoad -= w;
+        if (activeParcels > 0) activeParcels--;
+        if (currentLoad <= 0.0001) {
+            currentLoad = 0;
+            status = "Idle";
+        }
+    }
     
     void reset() {
         currentLoad = 0;
+        activeParcels = 0;
         status = "Idle";
     }
     
@@ -288,6 +1005,14 @@ struct ParcelNode {
     ParcelNode* prev;
     
     ParcelNode(Parcel* val) : data(val), next(nullptr), prev(nullptr) {}
+
+    static FixedBlockPool& pool() {
+        static FixedBlockPool* parked = nullptr;
+        static thread_local PoolHandle p(parked, sizeof(ParcelNode), POOL_SLAB_BLOCKS);
+        return p.get();
+    }
+    static void* operator new(size_t) { return pool().allocate(); }
+    static void operator delete(void* ptr) { pool().release(ptr); }
 };
 
 class ParcelList {
@@ -298,7 +1023,8 @@ public:
 
     ParcelList() : head(nullptr), tail(nullptr), size(0) {}
 
-    void pushBack(Parcel* val) {
+    // Returns the new node so callers can keep it as a handle for removeNode()
+    ParcelNode* pushBack(Parcel* val) {
         ParcelNode* newNode = new ParcelNode(val);
         if (!head) {
             head = tail = newNode;
@@ -308,30 +1034,27 @@ public:
             tail = newNode;
         }
         size++;
+        return newNode;
     }
 
-    bool remove(Parcel* val) {
-        ParcelNode* curr = head;
-        while (curr) {
-            if (curr->data == val) {
-                if (curr == head) {
-                    head = head->next;
-                    if (head) head->prev = nullptr;
-                    else tail = nullptr;
-                } else if (curr == tail) {
-                    tail = tail->prev;
-                    tail->next = nullptr;
-                } else {
-                    curr->prev->next = curr->next;
-                    curr->next->prev = curr->prev;
-                }
-                delete curr;
-                size--;
-                return true;
-            }
-            curr = curr->next;
-        }
-        return false;
+    ParcelNode* pushFront(Parcel* val) {
+        ParcelNode* newNode = new ParcelNode(val);
+        newNode->next = head;
+        if (head) head->prev = newNode;
+        else tail = newNode;
+        head = newNode;
+        size++;
+        return newNode;
+    }
+
+    // O(1) unlink through a handle returned by pushBack (node must belong to this list)
+    void removeNode(ParcelNode* node) {
+        if (node->prev) node->prev->next = node->next;
+        else head = node->next;
+        if (node->next) node->next->prev = node->prev;
+        else tail = node->prev;
+        delete node;
+        size--;
     }
     
     Parcel* popFront() {
@@ -369,14 +1092,71 @@ class ParcelQueue {
 private:
     ParcelList list;
 public:
-    void enqueue(Parcel* val) { list.pushBack(val); }
+    ParcelNode* enqueue(Parcel* val) { return list.pushBack(val); }
+    ParcelNode* requeueFront(Parcel* val) { return list.pushFront(val); }
     Parcel* dequeue() { return list.popFront(); }
+    void removeNode(ParcelNode* node) { list.removeNode(node); }
     Parcel* peek() { return list.head ? list.head->data : nullptr; }
     bool isEmpty() { return list.isEmpty(); }
     int count() { return list.size; }
     ParcelNode* getHead() { return list.head; }
 };
 
+// Lock-free multi-producer / single-consumer variant for the pickup intake
+// (Vyukov's intrusive MPSC queue). A producer links its own node with one atomic
+// exchange and never waits, however many others are pushing; the single consumer
+// drains in batches. A node must stay alive until the consumer has popped it.
+struct MpscLink {
+    atomic<MpscLink*> mpscNext;
+    MpscLink() : mpscNext(nullptr) {}
+};
+
+class MpscQueue {
+private:
+    alignas(64) atomic<MpscLink*> head;   // Newest node; producers swap themselves in
+    alignas(64) MpscLink* tail;           // Oldest node (consumer only)
+    MpscLink stub;                        // Keeps the list non-empty between pushes
+
+public:
+    MpscQueue() : head(&stub), tail(&stub) {}
+
+    // Any thread
+    void push(MpscLink* n) {
+        n->mpscNext.store(nullptr, memory_order_relaxed);
+        MpscLink* prev = head.exchange(n, memory_order_acq_rel);
+        prev->mpscNext.store(n, memory_order_release);
+    }
+
+    // Consumer only. Returns nullptr when empty, or while the newest producer is
+    // between its exchange and its link (the node shows up on the next call).
+    MpscLink* pop() {
+        MpscLink* t = tail;
+        MpscLink* next = t->mpscNext.load(memory_order_acquire);
+        if (t == &stub) {
+            if (!next) return nullptr;
+            tail = next;
+            t = next;
+            next = next->mpscNext.load(memory_order_acquire);
+        }
+        if (next) {
+            tail = next;
+            return t;
+        }
+        if (t != head.load(memory_order_acquire)) return nullptr;
+        // t is the last node: park the stub behind it so t can be handed out
+        push(&stub);
+        next = t->mpscNext.load(memory_order_acquire);
+        if (next) {
+            tail = next;
+            return t;
+        }
+        return nullptr;
+    }
+
+    // Consumer only
+    bool isEmpty() { return tail == &stub && head.load() == &stub; }
+};
+
 // --- 4.3 TEMPORARY STACK FOR PARCELS ---
 class ParcelStack {
 private:
@@ -388,54 +1168,169 @@ public:
     void clear() { while(!isEmpty()) pop(); }
 };
 
-// --- 4.4 UNDO LOG STACK ---
-struct ActionLog {
-    string actionType; 
-    Parcel* parcelPtr;
-    Rider* riderPtr; 
+// --- 4.4 COMMAND LOG (BOUNDED, TRANSACTIONAL UNDO) ---
+// Every undoable change is recorded as a small command in a fixed ring. Commands
+// are grouped into transactions (one registration, one pickup run, one dispatch
+// wave, one road update) and undo always reverts the newest transaction as a
+// whole. Parcels are referenced by ID, so a command whose parcel has since been
+// moved to the cold tier simply no longer resolves. When the ring wraps, the
+// oldest transactions fall off: memory is fixed, only history depth is lost.
+enum CommandType {
+    CMD_REGISTER,   // target = parcel ID
+    CMD_PICKUP,     // target = parcel ID (pickup queue -> warehouse)
+    CMD_DISPATCH,   // target = parcel ID, arg = rider fleet slot
+    CMD_ROAD        // target = u * MAX_CITIES + v, arg = previous factor, before = previous status
+};
+
+enum TransactionKind {
+    TXN_REGISTER,
+    TXN_PICKUP_RUN,
+    TXN_MANUAL_DISPATCH,
+    TXN_AUTO_WAVE,
+    TXN_ROAD_UPDATE,
+    TXN_COUNTER_BATCH,
+    TXN_TRAFFIC_FEED,
+    TXN_COUNT
+};
+
+const string TRANSACTION_NAMES[TXN_COUNT] = {
+    "Parcel Registration", "Pickup Processing", "Manual Dispatch", "Auto-Dispatch Wave", "Road Status Update",
+    "Counter Registrations", "Traffic Feed"
+};
+
+struct Command {
+    int target;
+    short arg;
+    unsigned char type;
+    unsigned char before;
 };
 
-struct ActionLogNode {
-    ActionLog data;
-    ActionLogNode* next;
-    ActionLogNode(ActionLog val) : data(val), next(nullptr) {}
+struct Transaction {
+    long long firstSeq;   // First command (sequence numbers never repeat)
+    long long endSeq;     // One past the last command
+    time_t openedAt;
+    int kind;
+    int detail;           // Parcel ID or city pair shown in the log view
 };
 
-class UndoStack {
+class CommandLog {
 private:
-    ActionLogNode* top;
+    Command* ring;
+    Transaction* txns;
+    long long nextSeq;    // Sequence number of the next command
+    long long oldestSeq;  // Oldest command still in the ring
+    int txnBottom;        // Ring position of the oldest kept transaction
+    int txnCount;
+    bool open;            // The newest transaction is still collecting commands
+    long long oversized;  // Transactions dropped for outgrowing the whole ring
+
+    Transaction& txnAt(int i) { return txns[(txnBottom + i) % COMMAND_TXN_CAPACITY]; }
+
+    // Drops transactions whose first command the ring has already overwritten
+    void dropOverwritten() {
+        while (txnCount > 0 && txnAt(0).firstSeq < oldestSeq) {
+            txnBottom = (txnBottom + 1) % COMMAND_TXN_CAPACITY;
+            txnCount--;
+            if (txnCount == 0) open = false;
+        }
+    }
+
 public:
-    UndoStack() : top(nullptr) {}
-    
-    void push(ActionLog val) {
-        ActionLogNode* n = new ActionLogNode(val);
-        n->next = top;
-        top = n;
+    CommandLog() : ring(new Command[COMMAND_LOG_CAPACITY]), txns(new Transaction[COMMAND_TXN_CAPACITY]),
+                   nextSeq(0), oldestSeq(0), txnBottom(0), txnCount(0), open(false), oversized(0) {}
+
+    ~CommandLog() {
+        delete[] ring;
+        delete[] txns;
     }
-    
-    ActionLog pop() {
-        if(!top) return ActionLog{"", nullptr, nullptr};
-        ActionLogNode* temp = top;
-        ActionLog val = temp->data;
-        top = top->next;
-        delete temp;
-        return val;
+
+    void begin(TransactionKind kind, int detail = 0) {
+        end();
+        if (txnCount == COMMAND_TXN_CAPACITY) {
+            txnBottom = (txnBottom + 1) % COMMAND_TXN_CAPACITY;
+            txnCount--;
+        }
+        Transaction& t = txnAt(txnCount++);
+        t.firstSeq = t.endSeq = nextSeq;
+        t.openedAt = ClockService::now();
+        t.kind = kind;
+        t.detail = detail;
+        open = true;
+    }
+
+    // Closes the open transaction; an empty one is discarded
+    void end() {
+        if (!open) return;
+        open = false;
+        if (recent(0).endSeq == recent(0).firstSeq) txnCount--;
+    }
+
+    // Commands outside begin()/end() are not undoable. A transaction that would
+    // outgrow the ring can no longer be undone whole, so it is dropped at that
+    // point and counted; the rest of its commands go unrecorded.
+    void record(CommandType type, int target, int arg = 0, int before = 0) {
+        if (!open) return;
+        if (nextSeq - recent(0).firstSeq == COMMAND_LOG_CAPACITY) {
+            txnCount--;
+            open = false;
+            oversized++;
+            return;
+        }
+        Command& c = ring[nextSeq % COMMAND_LOG_CAPACITY];
+        c.target = target;
+        c.arg = (short)arg;
+        c.type = (unsigned char)type;
+        c.before = (unsigned char)before;
+        nextSeq++;
+        recent(0).endSeq = nextSeq;
+        if (nextSeq - oldestSeq > COMMAND_LOG_CAPACITY) {
+            oldestSeq = nextSeq - COMMAND_LOG_CAPACITY;
+            dropOverwritten();
+        }
+    }
+
+    bool isEmpty() { return txnCount == 0; }
+    int transactions() { return txnCount; }
+    long long commandsHeld() { return txnCount ? nextSeq - txnAt(0).firstSeq : 0; }
+    long long oversizedDropped() { return oversized; }
+
+    // i = 0 is the newest transaction; 0 <= i < transactions()
+    Transaction& recent(int i) { return txnAt(txnCount - 1 - i); }
+    // An all-zero transaction when the log is empty
+    Transaction latest() {
+        if (txnCount == 0) return Transaction();
+        return recent(0);
+    }
+    Command& at(long long seq) { return ring[seq % COMMAND_LOG_CAPACITY]; }
+
+    // Labels the open transaction; a no-op once it has been closed or dropped
+    void setDetail(int detail) {
+        if (open) recent(0).detail = detail;
+    }
+
+    // Removes the newest closed transaction and hands its commands back to the ring
+    Transaction popLatest() {
+        end();
+        Transaction t = latest();
+        if (txnCount == 0) return t;
+        txnCount--;
+        nextSeq = t.firstSeq;
+        return t;
     }
-    
-    bool isEmpty() { return top == nullptr; }
 };
 
 // --- 4.5 MIN-HEAP (PRIORITY QUEUE) ---
 class ParcelPriorityQueue {
 private:
-    Parcel* heap[500]; 
+    Parcel** heap;
+    int heapCapacity;
     int heapSize;
 
     bool isHigherPriority(Parcel* p1, Parcel* p2) {
         if (p1->priorityLevel < p2->priorityLevel) return true;
         if (p1->priorityLevel > p2->priorityLevel) return false;
-        if (p1->weight > p2->weight) return true;
-        if (p1->weight < p2->weight) return false;
+        if (p1->weightGrams > p2->weightGrams) return true;
+        if (p1->weightGrams < p2->weightGrams) return false;
         return p1->id < p2->id;
     }
 
@@ -464,18 +1359,43 @@ private:
     }
 
 public:
-    ParcelPriorityQueue() : heapSize(0) {}
+    ParcelPriorityQueue()
+        : heap(new Parcel*[WAREHOUSE_HEAP_SIZE]), heapCapacity(WAREHOUSE_HEAP_SIZE), heapSize(0) {}
+
+    ~ParcelPriorityQueue() {
+        delete[] heap;
+    }
+
+    ParcelPriorityQueue(const ParcelPriorityQueue&) = delete;
+    ParcelPriorityQueue& operator=(const ParcelPriorityQueue&) = delete;
 
     void insert(Parcel* p) {
-        if (heapSize >= 500) {
-            cout << RED << " [!] Warehouse Full! Cannot accept new parcels." << RESET << endl;
-            return;
+        if (heapSize == heapCapacity) {
+            Parcel** grown = new Parcel*[heapCapacity * 2];
+            for (int i = 0; i < heapSize; i++) grown[i] = heap[i];
+            delete[] heap;
+            heap = grown;
+            heapCapacity *= 2;
         }
         heap[heapSize] = p;
         heapifyUp(heapSize);
         heapSize++;
     }
 
+    // Linear search: only undo pulls a parcel out of the middle of the heap
+    bool remove(Parcel* p) {
+        for (int i = 0; i < heapSize; i++) {
+            if (heap[i] != p) continue;
+            heap[i] = heap[--heapSize];
+            if (i < heapSize) {
+                heapifyUp(i);
+                heapifyDown(i);
+            }
+            return true;
+        }
+        return false;
+    }
+
     Parcel* extractMin() {
         if (heapSize == 0) return nullptr;
         Parcel* top = heap[0];
@@ -492,180 +1412,2865 @@ public:
 };
 
 // --- 4.6 HASH TABLE (FOR TRACKING) ---
+// Open addressing with Robin Hood probing. Each slot keeps the id -> Parcel*
+// pair inline plus its distance from the home slot; an insert that has probed
+// further than the resident entry takes its place, which keeps every probe
+// sequence short. The table doubles when the load factor passes
+// HASH_MAX_LOAD_PERCENT, so lookups stay O(1) regardless of volume.
 class TrackingHashTable {
 private:
-    ParcelList* buckets[HASH_TABLE_SIZE];
+    struct Slot {
+        int key;
+        int probeDist;   // -1 marks an empty slot
+        Parcel* value;
+    };
+
+    Slot* slots;
+    int capacity;        // Always a power of two
+    int shift;           // 32 - log2(capacity), for Fibonacci hashing
+    int count;
 
+    // Multiplicative (Fibonacci) hashing spreads sequential parcel IDs evenly
     int hashFunc(int id) {
-        return id % HASH_TABLE_SIZE;
+        return (int)(((unsigned int)id * 2654435769u) >> shift);
     }
 
-public:
-    TrackingHashTable() {
-        for (int i = 0; i < HASH_TABLE_SIZE; i++) {
-            buckets[i] = new ParcelList();
+    void allocate(int cap) {
+        capacity = cap;
+        shift = 32;
+        while (cap > 1) { cap >>= 1; shift--; }
+        slots = new Slot[capacity];
+        for (int i = 0; i < capacity; i++) {
+            slots[i].key = 0;
+            slots[i].probeDist = -1;
+            slots[i].value = nullptr;
         }
     }
 
-    void insert(Parcel* p) {
-        int idx = hashFunc(p->id);
-        buckets[idx]->pushBack(p);
+    void placeEntry(int key, Parcel* value) {
+        int mask = capacity - 1;
+        int idx = hashFunc(key);
+        int dist = 0;
+        while (true) {
+            Slot& s = slots[idx];
+            if (s.probeDist < 0) {
+                s.key = key;
+                s.value = value;
+                s.probeDist = dist;
+                return;
+            }
+            if (s.probeDist < dist) {
+                // Robin Hood: the richer resident gives up its slot and moves on
+                swap(s.key, key);
+                swap(s.value, value);
+                swap(s.probeDist, dist);
+            }
+            idx = (idx + 1) & mask;
+            dist++;
+        }
     }
 
-    Parcel* search(int id) {
-        int idx = hashFunc(id);
-        ParcelNode* curr = buckets[idx]->head;
-        while (curr) {
-            if (curr->data->id == id) return curr->data;
-            curr = curr->next;
+    void grow() {
+        Slot* old = slots;
+        int oldCap = capacity;
+        allocate(oldCap * 2);
+        for (int i = 0; i < oldCap; i++) {
+            if (old[i].probeDist >= 0) placeEntry(old[i].key, old[i].value);
         }
-        return nullptr;
+        delete[] old;
     }
-};
 
-// --- 4.7 BINARY SEARCH TREE ---
-struct ParcelTreeNode {
-    Parcel* data;
-    ParcelTreeNode* left;
-    ParcelTreeNode* right;
-    ParcelTreeNode(Parcel* val) : data(val), left(nullptr), right(nullptr) {}
+public:
+    TrackingHashTable() : count(0) {
+        allocate(HASH_TABLE_SIZE);
+    }
+
+    ~TrackingHashTable() {
+        delete[] slots;
+    }
+
+    void insert(Parcel* p) {
+        if ((long long)(count + 1) * 100 > (long long)capacity * HASH_MAX_LOAD_PERCENT) grow();
+        placeEntry(p->id, p);
+        count++;
+    }
+
+    Parcel* search(int id) {
+        int mask = capacity - 1;
+        int idx = hashFunc(id);
+        for (int dist = 0; ; dist++) {
+            Slot& s = slots[idx];
+            // An empty slot, or a resident closer to home than we are, ends the probe
+            if (s.probeDist < dist) return nullptr;
+            if (s.key == id) return s.value;
+            idx = (idx + 1) & mask;
+        }
+    }
+
+    // Backward-shift deletion: the rest of the probe run slides back one slot,
+    // so no tombstones are left and probe sequences stay as short as before
+    void remove(int id) {
+        int mask = capacity - 1;
+        int idx = hashFunc(id);
+        for (int dist = 0; ; dist++) {
+            Slot& s = slots[idx];
+            if (s.probeDist < dist) return;
+            if (s.key == id) break;
+            idx = (idx + 1) & mask;
+        }
+        int nextIdx = (idx + 1) & mask;
+        while (slots[nextIdx].probeDist > 0) {
+            slots[idx] = slots[nextIdx];
+            slots[idx].probeDist--;
+            idx = nextIdx;
+            nextIdx = (nextIdx + 1) & mask;
+        }
+        slots[idx].probeDist = -1;
+        slots[idx].value = nullptr;
+        count--;
+    }
+
+    int size() { return count; }
+};
+
+// --- 4.7 B+ TREE ARCHIVE ---
+// Parcel IDs arrive mostly in increasing order, which turned the old unbalanced
+// BST into a linked list. A B+ tree stays balanced, keeps keys packed together
+// in wide nodes, and chains its leaves so range scans are a linear walk.
+struct ArchiveKey {
+    long long major; // Parcel ID, or completion time for the time index
+    int id;          // Tie-breaker so equal times stay distinct
+};
+
+bool archiveKeyLess(const ArchiveKey& a, const ArchiveKey& b) {
+    if (a.major != b.major) return a.major < b.major;
+    return a.id < b.id;
+}
+
+struct BPlusNode {
+    bool isLeaf;
+    int numKeys;
+    ArchiveKey keys[BPLUS_ORDER];          // One spare slot absorbs the overflow before a split
+    BPlusNode* children[BPLUS_ORDER + 1];  // Internal nodes only
+    Parcel* values[BPLUS_ORDER];           // Leaves only
+    BPlusNode* next;                       // Leaf chain for range scans
+
+    BPlusNode(bool leaf) : isLeaf(leaf), numKeys(0), next(nullptr) {}
+
+    static FixedBlockPool& pool() {
+        static FixedBlockPool* parked = nullptr;
+        static thread_local PoolHandle p(parked, sizeof(BPlusNode), 64);
+        return p.get();
+    }
+    static void* operator new(size_t) { return pool().allocate(); }
+    static void operator delete(void* ptr) { pool().release(ptr); }
+};
+
+// Position inside the leaf chain; advance() walks keys in ascending order
+struct ArchiveCursor {
+    BPlusNode* leaf;
+    int pos;
+
+    bool isValid() { return leaf != nullptr; }
+    Parcel* value() { return leaf->values[pos]; }
+    ArchiveKey key() { return leaf->keys[pos]; }
+    void advance() {
+        pos++;
+        if (pos >= leaf->numKeys) {
+            leaf = leaf->next;
+            pos = 0;
+        }
+    }
+};
+
+class BPlusTree {
+private:
+    static const int MAX_KEYS = BPLUS_ORDER - 1;
+    static const int MAX_DEPTH = 32;
+
+    BPlusNode* root;
+    int count;
+
+    // Index of the first key strictly greater than k (child to descend into)
+    int upperBound(BPlusNode* node, const ArchiveKey& k) {
+        int lo = 0, hi = node->numKeys;
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            if (archiveKeyLess(k, node->keys[mid])) hi = mid;
+            else lo = mid + 1;
+        }
+        return lo;
+    }
+
+    // Index of the first key not less than k
+    int lowerBound(BPlusNode* node, const ArchiveKey& k) {
+        int lo = 0, hi = node->numKeys;
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            if (archiveKeyLess(node->keys[mid], k)) lo = mid + 1;
+            else hi = mid;
+        }
+        return lo;
+    }
+
+public:
+    BPlusTree() : root(nullptr), count(0) {}
+
+    void insert(ArchiveKey k, Parcel* p) {
+        if (!root) root = new BPlusNode(true);
+
+        // Iterative descent: the path replaces the recursion of the old BST
+        BPlusNode* path[MAX_DEPTH];
+        int depth = 0;
+        BPlusNode* node = root;
+        while (!node->isLeaf) {
+            path[depth++] = node;
+            node = node->children[upperBound(node, k)];
+        }
+
+        int pos = lowerBound(node, k);
+        if (pos < node->numKeys && !archiveKeyLess(k, node->keys[pos])) {
+            node->values[pos] = p; // Already archived
+            return;
+        }
+        for (int i = node->numKeys; i > pos; i--) {
+            node->keys[i] = node->keys[i - 1];
+            node->values[i] = node->values[i - 1];
+        }
+        node->keys[pos] = k;
+        node->values[pos] = p;
+        node->numKeys++;
+        count++;
+        if (node->numKeys <= MAX_KEYS) return;
+
+        // Split the leaf. Appends to the rightmost leaf (the common case for
+        // increasing IDs and times) leave the old leaf full instead of half empty.
+        BPlusNode* right = new BPlusNode(true);
+        int mid = (pos == node->numKeys - 1 && !node->next) ? node->numKeys - 1 : node->numKeys / 2;
+        for (int i = mid; i < node->numKeys; i++) {
+            right->keys[i - mid] = node->keys[i];
+            right->values[i - mid] = node->values[i];
+        }
+        right->numKeys = node->numKeys - mid;
+        node->numKeys = mid;
+        right->next = node->next;
+        node->next = right;
+        ArchiveKey sep = right->keys[0];
+
+        // Push separators up until a parent has room
+        while (depth > 0) {
+            BPlusNode* parent = path[--depth];
+            int cpos = upperBound(parent, sep);
+            for (int i = parent->numKeys; i > cpos; i--) {
+                parent->keys[i] = parent->keys[i - 1];
+                parent->children[i + 1] = parent->children[i];
+            }
+            parent->keys[cpos] = sep;
+            parent->children[cpos + 1] = right;
+            parent->numKeys++;
+            if (parent->numKeys <= MAX_KEYS) return;
+
+            BPlusNode* sibling = new BPlusNode(false);
+            int pmid = parent->numKeys / 2;
+            ArchiveKey up = parent->keys[pmid];
+            for (int i = pmid + 1; i < parent->numKeys; i++) {
+                sibling->keys[i - pmid - 1] = parent->keys[i];
+            }
+            for (int i = pmid + 1; i <= parent->numKeys; i++) {
+                sibling->children[i - pmid - 1] = parent->children[i];
+            }
+            sibling->numKeys = parent->numKeys - pmid - 1;
+            parent->numKeys = pmid;
+            sep = up;
+            right = sibling;
+        }
+
+        BPlusNode* newRoot = new BPlusNode(false);
+        newRoot->keys[0] = sep;
+        newRoot->children[0] = root;
+        newRoot->children[1] = right;
+        newRoot->numKeys = 1;
+        root = newRoot;
+    }
+
+    // Cursor at the first key >= k
+    ArchiveCursor seek(ArchiveKey k) {
+        ArchiveCursor c = {nullptr, 0};
+        if (!root) return c;
+        BPlusNode* node = root;
+        while (!node->isLeaf) node = node->children[upperBound(node, k)];
+        c.leaf = node;
+        c.pos = lowerBound(node, k);
+        if (c.pos >= node->numKeys) {
+            c.leaf = node->next;
+            c.pos = 0;
+        }
+        return c;
+    }
+
+    void clear() {
+        freeSubtree(root);
+        root = nullptr;
+        count = 0;
+    }
+
+    void freeSubtree(BPlusNode* node) {
+        if (!node) return;
+        if (!node->isLeaf) {
+            for (int i = 0; i <= node->numKeys; i++) freeSubtree(node->children[i]);
+        }
+        delete node;
+    }
+
+    int size() { return count; }
+};
+
+// Delivered-history archive with two orderings: by parcel ID and by completion time
+class ParcelArchive {
+private:
+    BPlusTree byId;
+    BPlusTree byTime;
+
+public:
+    void insert(Parcel* p) {
+        byId.insert(ArchiveKey{p->id, p->id}, p);
+        byTime.insert(ArchiveKey{(long long)fromParcelTime(p->completionTime), p->id}, p);
+    }
+
+    ArchiveCursor seekId(int fromId) { return byId.seek(ArchiveKey{fromId, INT_MIN}); }
+    ArchiveCursor seekTime(time_t from, int fromId = INT_MIN) { return byTime.seek(ArchiveKey{(long long)from, fromId}); }
+
+    int size() { return byId.size(); }
+    bool isEmpty() { return byId.size() == 0; }
+
+    // Called once every archived parcel has been moved to the cold tier
+    void clear() {
+        byId.clear();
+        byTime.clear();
+    }
+
+    void printTableHeader() {
+        cout << BLUE << " | " << setw(5) << "ID" 
+             << " | " << setw(12) << "SOURCE" 
+             << " | " << setw(12) << "DEST"
+             << " | " << setw(6) << "WGT"
+             << " | " << setw(5) << "PRI"
+             << " | " << setw(25) << "FINAL STATUS"
+             << " | " << setw(8) << "RIDER"
+             << " | " << RESET << endl;
+        UIHelper::printLine();
+    }
+};
+
+// --- 4.8 COLUMNAR PARCEL STORE (ANALYTICS) ---
+// Structure-of-arrays copy of the fields aggregate reports read. Scanning a few
+// dense arrays instead of chasing list nodes into 128-byte Parcels keeps
+// reports cache-friendly. Money and weight are stored as integers (paisa /
+// grams) so the masked reduction loops below auto-vectorise without needing
+// floating-point reassociation.
+class ParcelColumnStore {
+private:
+    unsigned char* statusCode;
+    unsigned char* priority;
+    long long* costPaisa;
+    int* weightGrams;
+    long long* creationTime;
+    long long* lastUpdateTime;
+    long long* dispatchTime;
+    Parcel** rows;
+    int count;
+    int capacity;
+
+    template <typename T>
+    static void growArray(T*& arr, int oldCap, int newCap) {
+        T* fresh = new T[newCap];
+        for (int i = 0; i < oldCap; i++) fresh[i] = arr[i];
+        delete[] arr;
+        arr = fresh;
+    }
+
+    void grow() {
+        int newCap = capacity ? capacity * 2 : 1024;
+        growArray(statusCode, capacity, newCap);
+        growArray(priority, capacity, newCap);
+        growArray(costPaisa, capacity, newCap);
+        growArray(weightGrams, capacity, newCap);
+        growArray(creationTime, capacity, newCap);
+        growArray(lastUpdateTime, capacity, newCap);
+        growArray(dispatchTime, capacity, newCap);
+        growArray(rows, capacity, newCap);
+        capacity = newCap;
+    }
+
+public:
+    ParcelColumnStore()
+        : statusCode(nullptr), priority(nullptr), costPaisa(nullptr), weightGrams(nullptr),
+          creationTime(nullptr), lastUpdateTime(nullptr), dispatchTime(nullptr), rows(nullptr),
+          count(0), capacity(0) {}
+
+    ~ParcelColumnStore() {
+        delete[] statusCode; delete[] priority; delete[] costPaisa; delete[] weightGrams;
+        delete[] creationTime; delete[] lastUpdateTime; delete[] dispatchTime; delete[] rows;
+    }
+
+    void add(Parcel* p) {
+        if (count == capacity) grow();
+        p->columnSlot = count++;
+        rows[p->columnSlot] = p;
+        sync(p);
+    }
+
+    // Swap-with-last keeps the columns dense when a parcel leaves memory
+    void remove(Parcel* p) {
+        int i = p->columnSlot;
+        if (i < 0) return;
+        int last = --count;
+        if (i != last) {
+            statusCode[i] = statusCode[last];
+            priority[i] = priority[last];
+            costPaisa[i] = costPaisa[last];
+            weightGrams[i] = weightGrams[last];
+            creationTime[i] = creationTime[last];
+            lastUpdateTime[i] = lastUpdateTime[last];
+            dispatchTime[i] = dispatchTime[last];
+            rows[i] = rows[last];
+            rows[i]->columnSlot = i;
+        }
+        p->columnSlot = -1;
+    }
+
+    // A history event moved lastUpdateTime and nothing else
+    void touch(Parcel* p) {
+        if (p->columnSlot >= 0) lastUpdateTime[p->columnSlot] = fromParcelTime(p->lastUpdateTime);
+    }
+
+    // Refresh a parcel's row after any field it mirrors has changed
+    void sync(Parcel* p) {
+        int i = p->columnSlot;
+        if (i < 0) return;
+        statusCode[i] = (unsigned char)p->getStatusCode();
+        priority[i] = (unsigned char)p->priorityLevel;
+        costPaisa[i] = p->costPaisa;
+        weightGrams[i] = (int)p->weightGrams;
+        creationTime[i] = fromParcelTime(p->creationTime);
+        lastUpdateTime[i] = fromParcelTime(p->lastUpdateTime);
+        dispatchTime[i] = p->dispatchTime ? fromParcelTime(p->dispatchTime) : 0;
+    }
+
+    // Per-status count, revenue and weight in one branch-free pass per status
+    void aggregateByStatus(long long counts[ST_COUNT], long long paisa[ST_COUNT], long long grams[ST_COUNT]) {
+        for (int k = 0; k < ST_COUNT; k++) {
+            long long n = 0, money = 0, mass = 0;
+            const unsigned char code = (unsigned char)k;
+            for (int i = 0; i < count; i++) {
+                long long m = (statusCode[i] == code);
+                n += m;
+                money += m * costPaisa[i];
+                mass += m * weightGrams[i];
+            }
+            counts[k] = n;
+            paisa[k] = money;
+            grams[k] = mass;
+        }
+    }
+
+    // Active (non-final) parcel whose last update is older than the cutoff
+    bool isStale(int slot, long long cutoff) {
+        unsigned char c = statusCode[slot];
+        bool active = (c == ST_PICKUP || c == ST_WAREHOUSE || c == ST_IN_TRANSIT || c == ST_RETURNING);
+        return active && lastUpdateTime[slot] < cutoff;
+    }
+
+    Parcel* rowAt(int slot) { return rows[slot]; }
+    int size() { return count; }
+};
+
+// --- 4.9 INCREMENTAL ANALYTICS COUNTERS ---
+// Running totals updated at every state transition, so dashboards read them in
+// O(1) instead of scanning the parcel book. Per-rider totals live on Rider.
+struct AnalyticsCounters {
+    long long totalRegistered;
+    long long byStatus[ST_COUNT];
+    long long revenuePaisa;                    // Delivered parcels only
+    long long cityRegistered[MAX_CITIES];      // By source city
+    long long cityDelivered[MAX_CITIES];       // By destination city
+    long long cityRevenuePaisa[MAX_CITIES];    // Delivered revenue by source city
+
+    AnalyticsCounters() : totalRegistered(0), revenuePaisa(0) {
+        for (int k = 0; k < ST_COUNT; k++) byStatus[k] = 0;
+        for (int c = 0; c < MAX_CITIES; c++) {
+            cityRegistered[c] = 0;
+            cityDelivered[c] = 0;
+            cityRevenuePaisa[c] = 0;
+        }
+    }
+
+    void onRegister(Parcel* p) {
+        totalRegistered++;
+        byStatus[p->getStatusCode()]++;
+        if (p->sourceCityID >= 0) cityRegistered[p->sourceCityID]++;
+    }
+
+    // A registration taken back by undo (the parcel never left the pickup queue)
+    void onUnregister(Parcel* p) {
+        totalRegistered--;
+        byStatus[p->getStatusCode()]--;
+        if (p->sourceCityID >= 0) cityRegistered[p->sourceCityID]--;
+    }
+
+    // `rider` is the fleet slot the parcel is indexed under, as in onRestore, so live
+    // and recovered totals credit the same rider even after a fleet reset
+    void onStatusChange(Parcel* p, int oldCode, int newCode, Rider* rider) {
+        if (oldCode == newCode) return;
+        byStatus[oldCode]--;
+        byStatus[newCode]++;
+        if (newCode == ST_DELIVERED) countDelivery(p, rider);
+    }
+
+    // Crash recovery: counts a parcel in its current state in one step
+    void onRestore(Parcel* p, Rider* deliveredBy) {
+        onRegister(p);
+        if (p->status == ST_DELIVERED) countDelivery(p, deliveredBy);
+    }
+
+    void countDelivery(Parcel* p, Rider* r) {
+        long long paisa = p->costPaisa;
+        revenuePaisa += paisa;
+        if (p->destCityID >= 0) cityDelivered[p->destCityID]++;
+        if (p->sourceCityID >= 0) cityRevenuePaisa[p->sourceCityID] += paisa;
+        if (r) {
+            r->deliveredCount++;
+            r->deliveredKg += p->weight();
+        }
+    }
+};
+
+// --- 4.10 TIME-BUCKETED CITY-PAIR ROLLUPS ---
+// Per (source, destination) pair, lifecycle events land in minute buckets.
+// When an hour closes its minutes are compacted into an hour bucket, and each
+// closed hour is folded into its day bucket. Every level is a ring indexed by
+// period number, so memory per pair is fixed, and a query only reads the
+// buckets of the window it asks about. Pairs are allocated on first use.
+struct RollupBucket {
+    long long period;        // Minute/hour/day number this bucket holds (-1 = empty)
+    bool folded;             // Already compacted into the next level
+    long long booked;        // Parcels registered
+    long long delivered;
+    long long grams;         // Delivered weight
+    long long revenuePaisa;  // Delivered revenue
+    long long latencySec;    // Sum of creation -> delivery times
+
+    void clear(long long p) {
+        period = p;
+        folded = false;
+        booked = delivered = grams = revenuePaisa = latencySec = 0;
+    }
+
+    void add(const RollupBucket& o) {
+        booked += o.booked;
+        delivered += o.delivered;
+        grams += o.grams;
+        revenuePaisa += o.revenuePaisa;
+        latencySec += o.latencySec;
+    }
+};
+
+struct PairRollup {
+    RollupBucket minutes[ROLLUP_MINUTES];
+    RollupBucket hours[ROLLUP_HOURS];
+    RollupBucket days[ROLLUP_DAYS];
+
+    PairRollup() {
+        for (int i = 0; i < ROLLUP_MINUTES; i++) minutes[i].clear(-1);
+        for (int i = 0; i < ROLLUP_HOURS; i++) hours[i].clear(-1);
+        for (int i = 0; i < ROLLUP_DAYS; i++) days[i].clear(-1);
+    }
+};
+
+class RollupEngine {
+private:
+    PairRollup* pairs[MAX_CITIES][MAX_CITIES];
+    PairRollup* active[MAX_CITIES * MAX_CITIES];
+    int activeCount;
+    long long offsetQuarter;  // UTC quarter-hour the cached offset belongs to
+    long long offsetSec;
+
+    // Seconds since the epoch on the local wall clock at t, so buckets follow local
+    // hours and days across DST changes. Offsets only change on a quarter hour,
+    // so one localtime_r per quarter serves every event inside it.
+    long long localSec(time_t t) {
+        long long quarter = (long long)t / 900;
+        if (quarter != offsetQuarter) {
+            tm local;
+            localtime_r(&t, &local);
+            offsetSec = local.tm_gmtoff;
+            offsetQuarter = quarter;
+        }
+        return (long long)t + offsetSec;
+    }
+
+    // UTC instant of a local wall-clock second (mktime picks one when the clock repeats it)
+    static time_t fromLocalSec(long long wall) {
+        time_t asUtc = (time_t)wall;
+        tm fields;
+        gmtime_r(&asUtc, &fields);
+        fields.tm_isdst = -1;
+        return mktime(&fields);
+    }
+
+    RollupBucket& slot(RollupBucket* ring, int ringSize, long long period) {
+        RollupBucket& b = ring[period % ringSize];
+        if (b.period != period) b.clear(period);
+        return b;
+    }
+
+    // Fold closed minutes into hours, and closed hours into days
+    void compactPair(PairRollup* pr, long long nowHour) {
+        for (int i = 0; i < ROLLUP_MINUTES; i++) {
+            RollupBucket& m = pr->minutes[i];
+            if (m.period < 0 || m.folded || m.period / 60 >= nowHour) continue;
+            RollupBucket& old = pr->hours[(m.period / 60) % ROLLUP_HOURS];
+            if (old.period >= 0 && old.period != m.period / 60 && !old.folded) {
+                slot(pr->days, ROLLUP_DAYS, old.period / 24).add(old);
+                old.folded = true;
+            }
+            slot(pr->hours, ROLLUP_HOURS, m.period / 60).add(m);
+            m.folded = true;
+        }
+        for (int i = 0; i < ROLLUP_HOURS; i++) {
+            RollupBucket& h = pr->hours[i];
+            if (h.period < 0 || h.folded || h.period >= nowHour) continue;
+            slot(pr->days, ROLLUP_DAYS, h.period / 24).add(h);
+            h.folded = true;
+        }
+    }
+
+    PairRollup* pairFor(int src, int dst) {
+        if (!pairs[src][dst]) {
+            pairs[src][dst] = new PairRollup();
+            active[activeCount++] = pairs[src][dst];
+        }
+        return pairs[src][dst];
+    }
+
+    RollupBucket& currentMinute(int src, int dst, time_t t) {
+        PairRollup* pr = pairFor(src, dst);
+        long long minute = localSec(t) / 60;
+        RollupBucket& b = pr->minutes[minute % ROLLUP_MINUTES];
+        if (b.period != minute) {
+            // Recycling a slot: make sure its old minute reached the hour level
+            if (b.period >= 0 && !b.folded) compactPair(pr, minute / 60);
+            b.clear(minute);
+        }
+        return b;
+    }
+
+    RollupBucket deliveryOf(Parcel* p, time_t t) {
+        RollupBucket d;
+        d.clear(0);
+        d.delivered = 1;
+        d.grams = p->weightGrams;
+        d.revenuePaisa = p->costPaisa;
+        d.latencySec = (long long)difftime(t, fromParcelTime(p->creationTime));
+        return d;
+    }
+
+    // Recovery replays events in storage order, not time order, so feeding them
+    // through currentMinute would recycle slots that hold newer periods. Instead
+    // each event goes straight to the level its age belongs to: the open hour's
+    // minutes, or an already-closed hour plus its day. Inside the retention
+    // windows every period has its own slot, so arrival order cannot matter.
+    void restore(int src, int dst, time_t t, time_t now, const RollupBucket& delta) {
+        long long minute = localSec(t) / 60, nowHour = localSec(now) / 3600;
+        long long hour = minute / 60, day = hour / 24;
+        if (hour <= nowHour - ROLLUP_HOURS && day <= nowHour / 24 - ROLLUP_DAYS) return;
+        PairRollup* pr = pairFor(src, dst);
+        if (hour >= nowHour) {
+            slot(pr->minutes, ROLLUP_MINUTES, minute).add(delta);
+            return;
+        }
+        if (hour > nowHour - ROLLUP_HOURS) {
+            RollupBucket& h = slot(pr->hours, ROLLUP_HOURS, hour);
+            h.add(delta);
+            h.folded = true;   // Counted in its day below
+        }
+        if (day > nowHour / 24 - ROLLUP_DAYS) slot(pr->days, ROLLUP_DAYS, day).add(delta);
+    }
+
+public:
+    RollupEngine() : activeCount(0), offsetQuarter(LLONG_MIN), offsetSec(0) {
+        for (int i = 0; i < MAX_CITIES; i++)
+            for (int j = 0; j < MAX_CITIES; j++) pairs[i][j] = nullptr;
+    }
+
+    void recordBooking(int src, int dst, time_t t) {
+        if (src < 0 || dst < 0) return;
+        currentMinute(src, dst, t).booked++;
+    }
+
+    // Takes back a booking while its minute bucket is still open; once compacted
+    // into the hour level the booking stays counted
+    void cancelBooking(int src, int dst, time_t t) {
+        if (src < 0 || dst < 0 || !pairs[src][dst]) return;
+        long long minute = localSec(t) / 60;
+        RollupBucket& b = pairs[src][dst]->minutes[minute % ROLLUP_MINUTES];
+        if (b.period == minute && !b.folded && b.booked > 0) b.booked--;
+    }
+
+    void recordDelivery(Parcel* p, time_t t) {
+        if (p->sourceCityID < 0 || p->destCityID < 0) return;
+        currentMinute(p->sourceCityID, p->destCityID, t).add(deliveryOf(p, t));
+    }
+
+    // Rebuild after a restart; events may arrive in any time order
+    void restoreBooking(int src, int dst, time_t t, time_t now) {
+        if (src < 0 || dst < 0) return;
+        RollupBucket d;
+        d.clear(0);
+        d.booked = 1;
+        restore(src, dst, t, now, d);
+    }
+
+    void restoreDelivery(Parcel* p, time_t t, time_t now) {
+        if (p->sourceCityID < 0 || p->destCityID < 0) return;
+        restore(p->sourceCityID, p->destCityID, t, now, deliveryOf(p, t));
+    }
+
+    // Periodic maintenance (called from the scheduler)
+    void compact(time_t now) {
+        long long nowHour = localSec(now) / 3600;
+        for (int i = 0; i < activeCount; i++) compactPair(active[i], nowHour);
+    }
+
+    // Totals for one local hour (hour number since epoch)
+    RollupBucket hourTotal(int src, int dst, long long hour, time_t now) {
+        RollupBucket sum;
+        sum.clear(hour);
+        PairRollup* pr = pairs[src][dst];
+        if (!pr) return sum;
+        long long nowHour = localSec(now) / 3600;
+        compactPair(pr, nowHour);
+        if (hour == nowHour) {
+            for (int i = 0; i < ROLLUP_MINUTES; i++)
+                if (pr->minutes[i].period >= 0 && pr->minutes[i].period / 60 == hour) sum.add(pr->minutes[i]);
+        } else {
+            RollupBucket& h = pr->hours[hour % ROLLUP_HOURS];
+            if (h.period == hour) sum.add(h);
+        }
+        return sum;
+    }
+
+    // Totals for one local day (day number since epoch); today includes the open hour
+    RollupBucket dayTotal(int src, int dst, long long day, time_t now) {
+        RollupBucket sum;
+        sum.clear(day);
+        PairRollup* pr = pairs[src][dst];
+        if (!pr) return sum;
+        long long nowHour = localSec(now) / 3600;
+        compactPair(pr, nowHour);
+        RollupBucket& d = pr->days[day % ROLLUP_DAYS];
+        if (d.period == day) sum.add(d);
+        if (day == nowHour / 24) sum.add(hourTotal(src, dst, nowHour, now));
+        return sum;
+    }
+
+    long long currentHour(time_t now) { return localSec(now) / 3600; }
+    long long currentDay(time_t now) { return localSec(now) / 86400; }
+    // Wall-clock start of a bucket, for display
+    time_t hourStart(long long hour) { return fromLocalSec(hour * 3600); }
+    time_t dayStart(long long day) { return fromLocalSec(day * 86400); }
+};
+
+// --- 4.11 SECONDARY PARCEL INDEXES ---
+// One list per status, source city, destination city and rider. Parcels keep
+// their node handles, so moving between lists is O(1) and a filtered view only
+// walks its own list instead of the whole master list.
+class ParcelIndexes {
+private:
+    ParcelList byStatus[ST_COUNT];
+    ParcelList bySource[MAX_CITIES];
+    ParcelList byDest[MAX_CITIES];
+    ParcelList byRider[MAX_FLEET];
+
+public:
+    void add(Parcel* p) {
+        p->indexedStatus = p->getStatusCode();
+        p->statusIndexNode = byStatus[p->indexedStatus].pushBack(p);
+        if (p->sourceCityID >= 0) p->sourceIndexNode = bySource[p->sourceCityID].pushBack(p);
+        if (p->destCityID >= 0) p->destIndexNode = byDest[p->destCityID].pushBack(p);
+    }
+
+    void onStatusChange(Parcel* p) {
+        int code = p->getStatusCode();
+        if (!p->statusIndexNode || code == p->indexedStatus) return;
+        byStatus[p->indexedStatus].removeNode(p->statusIndexNode);
+        p->indexedStatus = code;
+        p->statusIndexNode = byStatus[code].pushBack(p);
+    }
+
+    // fleetSlot = -1 clears the rider membership
+    void setRider(Parcel* p, int fleetSlot) {
+        if (p->indexedRider == fleetSlot) return;
+        if (p->riderIndexNode) {
+            byRider[p->indexedRider].removeNode(p->riderIndexNode);
+            p->riderIndexNode = nullptr;
+        }
+        p->indexedRider = fleetSlot;
+        if (fleetSlot >= 0) p->riderIndexNode = byRider[fleetSlot].pushBack(p);
+    }
+
+    void remove(Parcel* p) {
+        if (p->statusIndexNode) {
+            byStatus[p->indexedStatus].removeNode(p->statusIndexNode);
+            p->statusIndexNode = nullptr;
+        }
+        if (p->sourceIndexNode) {
+            bySource[p->sourceCityID].removeNode(p->sourceIndexNode);
+            p->sourceIndexNode = nullptr;
+        }
+        if (p->destIndexNode) {
+            byDest[p->destCityID].removeNode(p->destIndexNode);
+            p->destIndexNode = nullptr;
+        }
+        setRider(p, -1);
+    }
+
+    ParcelList& withStatus(int code) { return byStatus[code]; }
+    ParcelList& fromCity(int cityID) { return bySource[cityID]; }
+    ParcelList& toCity(int cityID) { return byDest[cityID]; }
+    ParcelList& withRider(int fleetSlot) { return byRider[fleetSlot]; }
+};
+
+// --- 4.12 WRITE-AHEAD LOG & SNAPSHOTS ---
+// Durable state is a stream of self-checking records, [type:1][length:4][fnv1a:4][payload],
+// shared by the log and the snapshot. A parcel record carries the whole parcel
+// (ParcelImage plus its history), so replay simply keeps the last image per id.
+// Names and routes go out as NAME / ROUTE records the first time a file
+// references them and are re-interned on load. Every log file opens with its generation number and a
+// snapshot ends with the generation it hands over to, so a log left behind by a
+// crash in the middle of a checkpoint is recognised as stale and skipped. The
+// snapshot also records the byte offset in the previous log where it was cut;
+// if the crash came before the new log replaced the old one, replay resumes the
+// old log from that offset instead.
+enum PersistRecordType {
+    REC_NAME = 1,      // file name id, text
+    REC_PARCEL,        // ParcelImage, history events
+    REC_ROAD,          // u, v, status (1 normal, 2 traffic, 3 blocked), traffic factor (1/1000)
+    REC_SCHEDULER,     // fill threshold, batching window
+    REC_LOG_BEGIN,     // generation of this log file
+    REC_SNAPSHOT_END,  // generation the following log must carry, parcel count, cut offset in the previous log
+    REC_DROP,          // parcel ID removed by undo
+    REC_COLD_MARK,     // cold rows made durable so far, highest cold parcel ID
+    REC_ROUTE          // file route id, city ids
+};
+
+struct ParcelImage {
+    int id;
+    unsigned int weightGrams;
+    unsigned int costPaisa;
+    ParcelTime creationTime;
+    ParcelTime lastUpdateTime;
+    ParcelTime dispatchTime;
+    ParcelTime completionTime;
+    unsigned short estimatedDurationSec;
+    unsigned short totalDistanceKm;
+    short sourceCityID;
+    short destCityID;
+    unsigned short sourceNameId;
+    unsigned short destNameId;
+    unsigned short routeId;
+    unsigned short riderNameId;
+    unsigned short historyCount;
+    unsigned char status;
+    unsigned char priorityLevel;
+    unsigned char flags;       // 1 = returning, 2 = will fail on path
+    signed char riderSlot;     // Rider index membership (see ParcelIndexes)
+    signed char carrierSlot;   // Fleet slot of the rider carrying it (-1 = none)
+};
+
+const size_t RECORD_HEADER_BYTES = 9;
+
+inline unsigned int persistChecksum(const char* data, size_t length) {
+    unsigned int h = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        h ^= (unsigned char)data[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// Builds records in a memory buffer and writes them out on flush()
+class RecordWriter {
+private:
+    FILE* file;
+    char* buffer;
+    size_t used;
+    size_t capacity;
+    bool* nameWritten;   // Name ids already present in this file
+    bool* routeWritten;  // Route ids already present in this file
+    long long fileBytes;
+
+    void reserve(size_t extra) {
+        if (used + extra <= capacity) return;
+        size_t newCap = capacity * 2;
+        while (newCap < used + extra) newCap *= 2;
+        char* grown = new char[newCap];
+        memcpy(grown, buffer, used);
+        delete[] buffer;
+        buffer = grown;
+        capacity = newCap;
+    }
+
+    size_t beginRecord(unsigned char type) {
+        reserve(RECORD_HEADER_BYTES);
+        size_t at = used;
+        buffer[at] = (char)type;
+        used += RECORD_HEADER_BYTES;
+        return at;
+    }
+
+    void append(const void* data, size_t length) {
+        reserve(length);
+        memcpy(buffer + used, data, length);
+        used += length;
+    }
+
+    void endRecord(size_t at) {
+        unsigned int length = (unsigned int)(used - at - RECORD_HEADER_BYTES);
+        unsigned int sum = persistChecksum(buffer + at + RECORD_HEADER_BYTES, length);
+        memcpy(buffer + at + 1, &length, 4);
+        memcpy(buffer + at + 5, &sum, 4);
+    }
+
+    void putName(unsigned short id) {
+        if (id == 0 || nameWritten[id]) return;
+        nameWritten[id] = true;
+        string text = NameTable::lookup(id);
+        size_t at = beginRecord(REC_NAME);
+        append(&id, sizeof(id));
+        append(text.data(), text.size());
+        endRecord(at);
+    }
+
+    void putRoute(unsigned short id) {
+        if (id == 0 || routeWritten[id]) return;
+        routeWritten[id] = true;
+        short cities[MAX_CITIES];
+        int n = RouteTable::cities(id, cities, MAX_CITIES);
+        size_t at = beginRecord(REC_ROUTE);
+        append(&id, sizeof(id));
+        append(cities, n * sizeof(short));
+        endRecord(at);
+    }
+
+public:
+    RecordWriter() : file(nullptr), buffer(new char[4096]), used(0), capacity(4096),
+                     nameWritten(new bool[65536]()), routeWritten(new bool[65536]()), fileBytes(0) {}
+
+    ~RecordWriter() {
+        close();
+        delete[] buffer;
+        delete[] nameWritten;
+        delete[] routeWritten;
+    }
+
+    bool open(const char* path, const char* mode) {
+        close();
+        file = fopen(path, mode);
+        forgetNames();
+        used = 0;
+        fileBytes = 0;
+        if (file && fseek(file, 0, SEEK_END) == 0) fileBytes = ftell(file);
+        return file != nullptr;
+    }
+
+    void close() {
+        if (!file) return;
+        flush(true);
+        fclose(file);
+        file = nullptr;
+    }
+
+    bool isOpen() { return file != nullptr; }
+    size_t buffered() { return used; }
+
+    // Names and routes go out again before their next use, so records written from here on
+    // can be read without anything earlier in the file
+    void forgetNames() {
+        for (int i = 0; i < 65536; i++) nameWritten[i] = routeWritten[i] = false;
+    }
+
+    // Copies records already framed by another writer
+    void appendRaw(const char* data, size_t length) { append(data, length); }
+    long long size() { return fileBytes + (long long)used; }
+
+    // durable = fsync as well, so the records survive power loss and not just a crash
+    bool flush(bool durable) {
+        if (!file) {
+            used = 0;
+            return false;
+        }
+        bool ok = true;
+        if (used > 0) {
+            ok = fwrite(buffer, 1, used, file) == used;
+            fileBytes += used;
+            used = 0;
+        }
+        if (fflush(file) != 0) ok = false;
+        if (durable && fsync(fileno(file)) != 0) ok = false;
+        return ok;
+    }
+
+    void putParcel(Parcel* p) {
+        EventChunk* first = p->historyTail ? p->historyTail->next : nullptr;
+        putName(p->sourceNameId);
+        putName(p->destNameId);
+        putRoute(p->routeId);
+        putName(p->riderNameId);
+        int seen = 0;
+        for (EventChunk* c = first; seen < p->historyCount; c = c->next) {
+            for (int i = 0; i < EVENT_CHUNK_CAPACITY && seen < p->historyCount; i++, seen++) {
+                if (c->events[i].code == EV_DISPATCHED) putName(c->events[i].arg);
+                else if (c->events[i].code == EV_ROUTE_ASSIGNED) putRoute(c->events[i].arg);
+            }
+        }
+
+        ParcelImage img;
+        memset(&img, 0, sizeof(img));
+        img.id = p->id;
+        img.weightGrams = p->weightGrams;
+        img.costPaisa = p->costPaisa;
+        img.creationTime = p->creationTime;
+        img.lastUpdateTime = p->lastUpdateTime;
+        img.dispatchTime = p->dispatchTime;
+        img.completionTime = p->completionTime;
+        img.estimatedDurationSec = p->estimatedDurationSec;
+        img.totalDistanceKm = p->totalDistanceKm;
+        img.sourceCityID = p->sourceCityID;
+        img.destCityID = p->destCityID;
+        img.sourceNameId = p->sourceNameId;
+        img.destNameId = p->destNameId;
+        img.routeId = p->routeId;
+        img.riderNameId = p->riderNameId;
+        img.historyCount = p->historyCount;
+        img.status = p->status;
+        img.priorityLevel = p->priorityLevel;
+        img.flags = (p->isReturning ? 1 : 0) | (p->willFailOnPath ? 2 : 0);
+        img.riderSlot = p->indexedRider;
+        img.carrierSlot = p->assignedRider ? (signed char)p->assignedRider->fleetIndex : -1;
+
+        size_t at = beginRecord(REC_PARCEL);
+        append(&img, sizeof(img));
+        seen = 0;
+        for (EventChunk* c = first; seen < p->historyCount; c = c->next) {
+            int n = min(EVENT_CHUNK_CAPACITY, p->historyCount - seen);
+            append(c->events, n * sizeof(ParcelEvent));
+            seen += n;
+        }
+        endRecord(at);
+    }
+
+    void putRoad(int u, int v, int status, int factor) {
+        int fields[4] = {u, v, status, factor};
+        size_t at = beginRecord(REC_ROAD);
+        append(fields, sizeof(fields));
+        endRecord(at);
+    }
+
+    void putScheduler(int fillThreshold, int windowSec) {
+        int fields[2] = {fillThreshold, windowSec};
+        size_t at = beginRecord(REC_SCHEDULER);
+        append(fields, sizeof(fields));
+        endRecord(at);
+    }
+
+    void putDrop(int id) {
+        size_t at = beginRecord(REC_DROP);
+        append(&id, sizeof(id));
+        endRecord(at);
+    }
+
+    void putColdMark(long long rows, long long maxId) {
+        long long fields[2] = {rows, maxId};
+        size_t at = beginRecord(REC_COLD_MARK);
+        append(fields, sizeof(fields));
+        endRecord(at);
+    }
+
+    void putLogBegin(long long generation) {
+        size_t at = beginRecord(REC_LOG_BEGIN);
+        append(&generation, sizeof(generation));
+        endRecord(at);
+    }
+
+    void putSnapshotEnd(long long nextGeneration, long long parcelCount, long long cutOffset) {
+        long long fields[3] = {nextGeneration, parcelCount, cutOffset};
+        size_t at = beginRecord(REC_SNAPSHOT_END);
+        append(fields, sizeof(fields));
+        endRecord(at);
+    }
+};
+
+// Group commit: a transition only marks its parcel dirty; commit() writes one
+// image per dirty parcel and pays a single fsync for the whole batch.
+class WriteAheadLog {
+private:
+    RecordWriter writer;
+    Parcel** pending;
+    int pendingCount;
+    int pendingCapacity;
+    long long generation;
+    long long commitCount;
+
+public:
+    WriteAheadLog() : pending(new Parcel*[WAL_GROUP_COMMIT_RECORDS]), pendingCount(0),
+                      pendingCapacity(WAL_GROUP_COMMIT_RECORDS), generation(0), commitCount(0) {}
+
+    ~WriteAheadLog() { delete[] pending; }
+
+    // Keeps appending to the log replayed at startup, cut back to its last whole
+    // record, when no snapshot could be written to take its place
+    bool resume(long long gen, long long validEnd) {
+        generation = gen;
+        if (validEnd <= 0) return start(gen);
+        if (truncate(WAL_PATH, validEnd) != 0) return false;
+        return writer.open(WAL_PATH, "ab");
+    }
+
+    // Replaces the log file with an empty one for the given generation
+    bool start(long long gen) {
+        generation = gen;
+        if (!writer.open(WAL_PATH, "wb")) return false;
+        writer.putLogBegin(gen);
+        return writer.flush(true);
+    }
+
+    void setGeneration(long long gen) { generation = gen; }
+    long long currentGeneration() { return generation; }
+
+    // Commits and marks the point a snapshot covers. Returns its byte offset.
+    long long cut() {
+        commit();
+        writer.forgetNames();
+        return writer.size();
+    }
+
+    // Once the snapshot cut at `from` is durable: the new generation's log starts
+    // with whatever was logged after the cut. It is built beside the old log and
+    // renamed over it, so a crash leaves one of the two intact. At startup no log
+    // is open yet and the new one simply starts empty.
+    bool handOver(long long gen, long long from) {
+        if (!writer.isOpen()) return start(gen);
+        commit();
+        string tmpPath = string(WAL_PATH) + ".tmp";
+        RecordWriter next;
+        FILE* old = fopen(WAL_PATH, "rb");
+        if (!old || fseek(old, from, SEEK_SET) != 0 || !next.open(tmpPath.c_str(), "wb")) {
+            if (old) fclose(old);
+            return false;
+        }
+        next.putLogBegin(gen);
+        char* chunk = new char[PERSIST_BUFFER_BYTES];
+        size_t n;
+        while ((n = fread(chunk, 1, PERSIST_BUFFER_BYTES, old)) > 0) {
+            next.appendRaw(chunk, n);
+            next.flush(false);
+        }
+        delete[] chunk;
+        fclose(old);
+        bool ok = next.flush(true);
+        next.close();
+        if (!ok || rename(tmpPath.c_str(), WAL_PATH) != 0) {
+            remove(tmpPath.c_str());
+            return false;
+        }
+        generation = gen;
+        return writer.open(WAL_PATH, "ab");
+    }
+
+    void markDirty(Parcel* p) {
+        if (p->walPending) return;
+        p->walPending = true;
+        if (pendingCount == pendingCapacity) {
+            Parcel** grown = new Parcel*[pendingCapacity * 2];
+            for (int i = 0; i < pendingCount; i++) grown[i] = pending[i];
+            delete[] pending;
+            pending = grown;
+            pendingCapacity *= 2;
+        }
+        pending[pendingCount++] = p;
+    }
+
+    void logRoad(int u, int v, int status, int factor) { writer.putRoad(u, v, status, factor); }
+    void logDrop(int id) { writer.putDrop(id); }
+    void logScheduler(int fillThreshold, int windowSec) { writer.putScheduler(fillThreshold, windowSec); }
+    void logColdMark(long long rows, long long maxId) { writer.putColdMark(rows, maxId); }
+
+    void commit() {
+        if (pendingCount == 0 && writer.buffered() == 0) return;
+        for (int i = 0; i < pendingCount; i++) {
+            pending[i]->walPending = false;
+            writer.putParcel(pending[i]);
+        }
+        pendingCount = 0;
+        writer.flush(true);
+        commitCount++;
+    }
+
+    // Called between parcels inside long loops so one action cannot build an unbounded batch
+    void commitIfFull() {
+        if (pendingCount >= WAL_GROUP_COMMIT_RECORDS) commit();
+    }
+
+    bool isOpen() { return writer.isOpen(); }
+    long long size() { return writer.size(); }
+    long long commits() { return commitCount; }
+};
+
+// Sequential reader; next() stops at end of file or at the first torn / corrupt record
+class RecordReader {
+private:
+    FILE* file;
+    char* payload;
+    size_t capacity;
+    unsigned short* nameMap;   // File name id -> NameTable id
+    unsigned short* routeMap;  // File route id -> RouteTable id
+    long long consumed;        // Bytes up to the end of the last whole record read
+
+public:
+    RecordReader() : file(nullptr), payload(new char[4096]), capacity(4096), nameMap(new unsigned short[65536]()),
+                     routeMap(new unsigned short[65536]()), consumed(0) {}
+
+    ~RecordReader() {
+        close();
+        delete[] payload;
+        delete[] nameMap;
+        delete[] routeMap;
+    }
+
+    bool open(const char* path) {
+        close();
+        file = fopen(path, "rb");
+        consumed = 0;
+        return file != nullptr;
+    }
+
+    void close() {
+        if (file) fclose(file);
+        file = nullptr;
+    }
+
+    bool seek(long long offset) {
+        if (!file || fseek(file, offset, SEEK_SET) != 0) return false;
+        consumed = offset;
+        return true;
+    }
+
+    long long validBytes() { return consumed; }
+
+    bool next(unsigned char& type, const char*& data, unsigned int& length) {
+        if (!file) return false;
+        char header[RECORD_HEADER_BYTES];
+        if (fread(header, 1, RECORD_HEADER_BYTES, file) != RECORD_HEADER_BYTES) return false;
+        unsigned int sum;
+        type = (unsigned char)header[0];
+        memcpy(&length, header + 1, 4);
+        memcpy(&sum, header + 5, 4);
+        if (length > (1u << 24)) return false; // Garbage length from a torn header
+        if (length > capacity) {
+            delete[] payload;
+            capacity = length;
+            payload = new char[capacity];
+        }
+        if (fread(payload, 1, length, file) != length) return false;
+        if (persistChecksum(payload, length) != sum) return false;
+        consumed += RECORD_HEADER_BYTES + length;
+        data = payload;
+        return true;
+    }
+
+    // False when the session table is full; the file id then stays unmapped (0)
+    bool readName(const char* data, unsigned int length) {
+        if (length < sizeof(unsigned short)) return true;
+        unsigned short id;
+        memcpy(&id, data, sizeof(id));
+        return NameTable::intern(string(data + sizeof(id), length - sizeof(id)), nameMap[id]);
+    }
+
+    bool readRoute(const char* data, unsigned int length) {
+        if (length < sizeof(unsigned short)) return true;
+        unsigned short id;
+        short cities[MAX_CITIES];
+        memcpy(&id, data, sizeof(id));
+        int n = (int)min((length - sizeof(id)) / sizeof(short), (size_t)MAX_CITIES);
+        memcpy(cities, data + sizeof(id), n * sizeof(short));
+        return RouteTable::intern(cities, n, routeMap[id]);
+    }
+
+    // Overwrites p with a parcel record (history replaced, names re-mapped) and
+    // reports the fleet slot of its carrier. False if the record is truncated.
+    bool readParcel(const char* data, unsigned int length, Parcel* p, int& carrierSlot) {
+        ParcelImage img;
+        memcpy(&img, data, sizeof(img));
+        if (length < sizeof(img) + img.historyCount * sizeof(ParcelEvent)) return false;
+        carrierSlot = img.carrierSlot;
+        p->weightGrams = img.weightGrams;
+        p->costPaisa = img.costPaisa;
+        p->creationTime = img.creationTime;
+        p->lastUpdateTime = img.lastUpdateTime;
+        p->dispatchTime = img.dispatchTime;
+        p->completionTime = img.completionTime;
+        p->estimatedDurationSec = img.estimatedDurationSec;
+        p->totalDistanceKm = img.totalDistanceKm;
+        p->sourceCityID = img.sourceCityID;
+        p->destCityID = img.destCityID;
+        p->sourceNameId = nameMap[img.sourceNameId];
+        p->destNameId = nameMap[img.destNameId];
+        p->routeId = routeMap[img.routeId];
+        p->riderNameId = nameMap[img.riderNameId];
+        p->status = img.status < ST_COUNT ? img.status : (unsigned char)ST_MISSING;
+        p->priorityLevel = img.priorityLevel;
+        p->isReturning = (img.flags & 1) != 0;
+        p->willFailOnPath = (img.flags & 2) != 0;
+        p->indexedRider = img.riderSlot; // Consumed by SwiftExEngine::attachRecovered
+
+        p->clearHistory();
+        const char* ev = data + sizeof(img);
+        for (int i = 0; i < img.historyCount; i++, ev += sizeof(ParcelEvent)) {
+            ParcelEvent e;
+            memcpy(&e, ev, sizeof(e));
+            if (e.code == EV_DISPATCHED) e.arg = nameMap[e.arg];
+            else if (e.code == EV_ROUTE_ASSIGNED) e.arg = routeMap[e.arg];
+            p->appendEvent(e);
+        }
+        return true;
+    }
+};
+
+// --- 4.13 COLD TIER (MEMORY-MAPPED COLUMNAR ARCHIVE) ---
+// Finished parcels leave RAM for five append-only files:
+//   swiftex.cold         header page + blocks of COLD_BLOCK_ROWS rows, column-major
+//                        inside each block, rows in completion-time order
+//   swiftex.cold.idx     open-addressed parcel ID -> row table
+//   swiftex.cold.events  history events of every row, back to back
+//   swiftex.cold.names   name dictionary referenced by the name columns
+//   swiftex.cold.routes  route dictionary (city id sequences) for the route column
+// The row, index and event files are memory-mapped; the page cache decides what
+// stays resident. A batch is durable once its rows and events are synced and the
+// header's rowCount moves past them, so a crash mid-append leaves the old archive.
+
+// Read/write shared mapping of a file that grows in place. Growth re-maps the
+// file, so pointers into it must be re-fetched after ensureSize().
+class MappedFile {
+private:
+    int fd;
+    char* base;
+    size_t mappedBytes;
+
+    bool map(size_t bytes) {
+        if (base) munmap(base, mappedBytes);
+        void* m = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (m == MAP_FAILED) {
+            base = nullptr;
+            mappedBytes = 0;
+            return false;
+        }
+        base = static_cast<char*>(m);
+        mappedBytes = bytes;
+        return true;
+    }
+
+public:
+    MappedFile() : fd(-1), base(nullptr), mappedBytes(0) {}
+    ~MappedFile() { close(); }
+
+    bool open(const char* path) {
+        close();
+        fd = ::open(path, O_RDWR | O_CREAT, 0644);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) return map((size_t)st.st_size);
+        return true;
+    }
+
+    void close() {
+        if (base) munmap(base, mappedBytes);
+        if (fd >= 0) ::close(fd);
+        base = nullptr;
+        mappedBytes = 0;
+        fd = -1;
+    }
+
+    // Grows the file (doubling) until it holds at least the given number of bytes
+    bool ensureSize(size_t bytes) {
+        if (bytes <= mappedBytes) return true;
+        size_t newSize = mappedBytes ? mappedBytes : 64 * 1024;
+        while (newSize < bytes) newSize *= 2;
+        if (ftruncate(fd, (off_t)newSize) != 0) return false;
+        return map(newSize);
+    }
+
+    // Writes back the pages covering [from, to)
+    void sync(size_t from, size_t to) {
+        if (!base || from >= to) return;
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        size_t start = from - from % page;
+        msync(base + start, min(to, mappedBytes) - start, MS_SYNC);
+    }
+
+    bool isOpen() { return base != nullptr; }
+    char* data() { return base; }
+    size_t size() { return mappedBytes; }
+};
+
+enum ColdColumn {
+    CC_ID, CC_WEIGHT, CC_COST, CC_CREATED, CC_DISPATCHED, CC_COMPLETED, CC_UPDATED, CC_EVENT_START,
+    CC_DURATION, CC_DISTANCE, CC_SRC_CITY, CC_DST_CITY, CC_SRC_NAME, CC_DST_NAME, CC_ROUTE, CC_RIDER_NAME, CC_EVENT_COUNT,
+    CC_STATUS, CC_PRIORITY, CC_FLAGS, CC_RIDER_SLOT,
+    CC_COUNT
+};
+
+// Widest columns first so every column starts naturally aligned inside a block
+const int COLD_COLUMN_BYTES[CC_COUNT] = {
+    4, 4, 4, 4, 4, 4, 4, 4,
+    2, 2, 2, 2, 2, 2, 2, 2, 2,
+    1, 1, 1, 1
+};
+
+const size_t COLD_HEADER_BYTES = 4096;
+
+struct ColdHeader {
+    char magic[8];
+    long long rowCount;
+    long long eventCount;
+    int maxId;
+};
+
+struct ColdIndexHeader {
+    long long capacity;      // Power of two
+    long long count;
+    long long indexedRows;   // Rows [0, indexedRows) are in the table
+};
+
+struct ColdIndexSlot {
+    int id;
+    unsigned int rowPlusOne; // 0 = empty
+};
+
+// Append-only file mapping in-memory ids (NameTable or RouteTable) to ids that
+// stay valid across runs. A name entry is its length and text; a route entry is
+// its city count and graph city ids. Dictionary id 0 is "None" / no route.
+class ColdDictionary {
+private:
+    const char* path;
+    bool holdsRoutes;
+    FILE* file;
+    unsigned short* toCold;     // In-memory id -> dictionary id (0xFFFF = not stored yet)
+    unsigned short* fromCold;   // Dictionary id -> in-memory id
+    int count;
+    bool full;                  // An id had to be refused; reported by the archive
+
+public:
+    ColdDictionary(const char* filePath, bool routes)
+        : path(filePath), holdsRoutes(routes), file(nullptr), toCold(new unsigned short[65536]),
+          fromCold(new unsigned short[65536]), count(1), full(false) {
+        for (int i = 0; i < 65536; i++) toCold[i] = 0xFFFF;
+        toCold[0] = 0;
+        fromCold[0] = 0;
+    }
+
+    ~ColdDictionary() {
+        if (file) fclose(file);
+        delete[] toCold;
+        delete[] fromCold;
+    }
+
+    // Re-interns every stored entry; false if one no longer fits the in-memory table
+    bool open() {
+        FILE* in = fopen(path, "rb");
+        if (in) {
+            unsigned short length;
+            // An entry can hold up to 0xFFFF units: too big for the stack
+            char* text = holdsRoutes ? nullptr : new char[65536];
+            short* route = holdsRoutes ? new short[65536] : nullptr;
+            long valid = 0;
+            bool ok = true;
+            while (count < 0xFFFF && fread(&length, sizeof(length), 1, in) == 1) {
+                unsigned short id;
+                if (holdsRoutes) {
+                    if (fread(route, sizeof(short), length, in) != length) break;
+                    ok = RouteTable::intern(route, length, id);
+                } else {
+                    if (fread(text, 1, length, in) != length) break;
+                    ok = NameTable::intern(string(text, length), id);
+                }
+                if (!ok) break;
+                fromCold[count] = id;
+                toCold[id] = (unsigned short)count;
+                count++;
+                valid = ftell(in);
+            }
+            fclose(in);
+            delete[] text;
+            delete[] route;
+            if (!ok) return false;
+            // Drop a record torn by a crash so the next append starts on a boundary
+            if (truncate(path, valid) != 0) return false;
+        }
+        file = fopen(path, "ab");
+        return file != nullptr;
+    }
+
+    bool isOpen() { return file != nullptr; }
+    bool isFull() { return full; }
+    int size() { return count; }
+
+    // Dictionary id of an in-memory id, appending it on first use. False when
+    // all 0xFFFF dictionary ids are taken.
+    bool store(unsigned short id, unsigned short& coldId) {
+        if (toCold[id] != 0xFFFF) {
+            coldId = toCold[id];
+            return true;
+        }
+        if (count == 0xFFFF) {
+            full = true;
+            return false;
+        }
+        if (holdsRoutes) {
+            short route[MAX_CITIES];
+            unsigned short length = (unsigned short)RouteTable::cities(id, route, MAX_CITIES);
+            fwrite(&length, sizeof(length), 1, file);
+            fwrite(route, sizeof(short), length, file);
+        } else {
+            string text = NameTable::lookup(id);
+            unsigned short length = (unsigned short)min(text.size(), (size_t)0xFFFF);
+            fwrite(&length, sizeof(length), 1, file);
+            fwrite(text.data(), 1, length, file);
+        }
+        toCold[id] = (unsigned short)count;
+        fromCold[count] = id;
+        coldId = (unsigned short)count++;
+        return true;
+    }
+
+    unsigned short fromColdId(unsigned short coldId) { return coldId < count ? fromCold[coldId] : 0; }
+
+    void sync() {
+        fflush(file);
+        fsync(fileno(file));
+    }
+};
+
+class ColdArchive {
+private:
+    MappedFile rowsFile;
+    MappedFile indexFile;
+    MappedFile eventsFile;
+    ColdDictionary names;
+    ColdDictionary routes;
+    size_t blockBytes;
+    size_t columnOffset[CC_COUNT];
+    long long flushCount;
+    int* sortedIds;             // Archived IDs in ascending order, for paging by ID
+    long long sortedCount;      // Rows merged into sortedIds so far
+    long long sortedCapacity;
+    long long stagedRow0;       // First row of the staged batch
+    long long stagedRows;       // 0 when nothing is staged
+    long long stagedEventEnd;
+    int stagedMaxId;
+
+    ColdHeader* header() { return reinterpret_cast<ColdHeader*>(rowsFile.data()); }
+    ColdIndexHeader* indexHeader() { return reinterpret_cast<ColdIndexHeader*>(indexFile.data()); }
+    ColdIndexSlot* indexSlots() { return reinterpret_cast<ColdIndexSlot*>(indexFile.data() + sizeof(ColdIndexHeader)); }
+    ParcelEvent* events() { return reinterpret_cast<ParcelEvent*>(eventsFile.data()); }
+
+    template <typename T>
+    T& cell(int column, long long row) {
+        char* block = rowsFile.data() + COLD_HEADER_BYTES + (size_t)(row / COLD_BLOCK_ROWS) * blockBytes;
+        return reinterpret_cast<T*>(block + columnOffset[column])[row % COLD_BLOCK_ROWS];
+    }
+
+    size_t rowsEnd(long long rows) {
+        long long blocks = (rows + COLD_BLOCK_ROWS - 1) / COLD_BLOCK_ROWS;
+        return COLD_HEADER_BYTES + (size_t)blocks * blockBytes;
+    }
+
+    static unsigned int slotFor(int id, long long capacity) {
+        return (unsigned int)(((unsigned int)id * 2654435769u) & (unsigned int)(capacity - 1));
+    }
+
+    void indexInsert(int id, long long row) {
+        ColdIndexHeader* h = indexHeader();
+        ColdIndexSlot* slots = indexSlots();
+        unsigned int mask = (unsigned int)(h->capacity - 1);
+        unsigned int i = slotFor(id, h->capacity);
+        while (slots[i].rowPlusOne != 0 && slots[i].id != id) i = (i + 1) & mask;
+        if (slots[i].rowPlusOne == 0) h->count++;
+        slots[i].id = id;
+        slots[i].rowPlusOne = (unsigned int)(row + 1);
+    }
+
+    // Re-creates the ID table from the id column (used to grow it, or after a crash)
+    bool rebuildIndex(long long capacity) {
+        size_t bytes = sizeof(ColdIndexHeader) + (size_t)capacity * sizeof(ColdIndexSlot);
+        if (!indexFile.ensureSize(bytes)) return false;
+        memset(indexFile.data(), 0, bytes);
+        indexHeader()->capacity = capacity;
+        long long rows = header()->rowCount;
+        for (long long r = 0; r < rows; r++) indexInsert(cell<int>(CC_ID, r), r);
+        indexHeader()->indexedRows = rows;
+        indexFile.sync(0, bytes);
+        return true;
+    }
+
+    static int compareIds(const void* a, const void* b) {
+        int x = *static_cast<const int*>(a), y = *static_cast<const int*>(b);
+        return (x > y) - (x < y);
+    }
+
+    // Sorts the rows appended since the last call and merges them into sortedIds
+    void catchUpSortedIds() {
+        long long rows = size();
+        if (sortedCount >= rows) return;
+        if (rows > sortedCapacity) {
+            long long capacity = max(rows, sortedCapacity * 2);
+            int* grown = new int[capacity];
+            if (sortedCount > 0) memcpy(grown, sortedIds, (size_t)sortedCount * sizeof(int));
+            delete[] sortedIds;
+            sortedIds = grown;
+            sortedCapacity = capacity;
+        }
+        long long n = rows - sortedCount;
+        int* fresh = new int[n];
+        for (long long i = 0; i < n; i++) fresh[i] = cell<int>(CC_ID, sortedCount + i);
+        qsort(fresh, (size_t)n, sizeof(int), compareIds);
+        // Merge from the back so neither run is overwritten before it is read
+        long long i = sortedCount - 1, j = n - 1, k = rows - 1;
+        while (j >= 0) sortedIds[k--] = (i >= 0 && sortedIds[i] > fresh[j]) ? sortedIds[i--] : fresh[j--];
+        delete[] fresh;
+        sortedCount = rows;
+    }
+
+    bool reserveIndex(long long extraRows) {
+        ColdIndexHeader* h = indexHeader();
+        long long needed = h->count + extraRows;
+        if (needed * 100 <= h->capacity * COLD_INDEX_LOAD_PERCENT) return true;
+        long long capacity = h->capacity;
+        while (needed * 100 > capacity * COLD_INDEX_LOAD_PERCENT) capacity *= 2;
+        return rebuildIndex(capacity);
+    }
+
+public:
+    ColdArchive()
+        : names(COLD_NAMES_PATH, false), routes(COLD_ROUTES_PATH, true), blockBytes(0), flushCount(0),
+          sortedIds(nullptr), sortedCount(0), sortedCapacity(0), stagedRow0(0), stagedRows(0), stagedEventEnd(0),
+          stagedMaxId(0) {
+        size_t offset = 0;
+        for (int c = 0; c < CC_COUNT; c++) {
+            columnOffset[c] = offset;
+            offset += (size_t)COLD_COLUMN_BYTES[c] * COLD_BLOCK_ROWS;
+        }
+        blockBytes = offset;
+    }
+
+    ~ColdArchive() {
+        delete[] sortedIds;
+    }
+
+    bool open() {
+        if (!rowsFile.open(COLD_ROWS_PATH) || !indexFile.open(COLD_INDEX_PATH) || !eventsFile.open(COLD_EVENTS_PATH)) return false;
+        if (!rowsFile.isOpen() || header()->magic[0] == 0) {
+            if (!rowsFile.ensureSize(COLD_HEADER_BYTES)) return false;
+            memcpy(header()->magic, "SWXCOLD1", 8);
+            header()->rowCount = 0;
+            header()->eventCount = 0;
+            header()->maxId = 0;
+            rowsFile.sync(0, COLD_HEADER_BYTES);
+        }
+        if (memcmp(header()->magic, "SWXCOLD1", 8) != 0) {
+            rowsFile.close();
+            return false;
+        }
+        if (!names.open() || !routes.open()) return false;
+
+        // The index is only a cache of the id column: rebuild it if it is missing
+        // or behind, e.g. after a crash between an append and its index update
+        long long rows = header()->rowCount;
+        if (!indexFile.isOpen() || indexHeader()->capacity == 0 || indexHeader()->indexedRows > rows) {
+            long long capacity = 1024;
+            while (rows * 100 > capacity * COLD_INDEX_LOAD_PERCENT) capacity *= 2;
+            if (!rebuildIndex(capacity)) return false;
+        } else if (indexHeader()->indexedRows < rows) {
+            if (!reserveIndex(rows - indexHeader()->indexedRows)) return false;
+            for (long long r = indexHeader()->indexedRows; r < rows; r++) indexInsert(cell<int>(CC_ID, r), r);
+            indexHeader()->indexedRows = rows;
+        }
+        return true;
+    }
+
+    bool isOpen() { return rowsFile.isOpen() && names.isOpen() && routes.isOpen(); }
+    bool dictionaryFull() { return names.isFull() || routes.isFull(); }
+    long long size() { return isOpen() ? header()->rowCount : 0; }
+    long long flushes() { return flushCount; }
+    long long eventCount() { return isOpen() ? header()->eventCount : 0; }
+    int maxParcelId() { return isOpen() ? header()->maxId : 0; }
+    size_t bytesOnDisk() { return rowsFile.size() + indexFile.size() + eventsFile.size(); }
+
+    // Appending takes three steps so the syncs can run without engineMutex, the
+    // way a checkpoint writes its snapshot. stageAppend copies a batch (already in
+    // completion-time order) into the rows past rowCount, which no reader looks
+    // at; syncStaged makes it durable; publishStaged advances the header's
+    // rowCount and indexes the rows. One batch is staged at a time.
+    bool stageAppend(Parcel** batch, int n) {
+        if (!isOpen() || n == 0) return n == 0;
+        long long row0 = header()->rowCount;
+        long long event0 = header()->eventCount;
+        long long totalEvents = 0;
+        for (int i = 0; i < n; i++) totalEvents += batch[i]->historyCount;
+
+        if (!rowsFile.ensureSize(rowsEnd(row0 + n))) return false;
+        if (!eventsFile.ensureSize((size_t)(event0 + totalEvents) * sizeof(ParcelEvent))) return false;
+        if (!reserveIndex(n)) return false;
+
+        long long ev = event0;
+        int maxId = header()->maxId;
+        for (int i = 0; i < n; i++) {
+            Parcel* p = batch[i];
+            long long r = row0 + i;
+            cell<int>(CC_ID, r) = p->id;
+            cell<unsigned int>(CC_WEIGHT, r) = p->weightGrams;
+            cell<unsigned int>(CC_COST, r) = p->costPaisa;
+            cell<unsigned int>(CC_CREATED, r) = p->creationTime;
+            cell<unsigned int>(CC_DISPATCHED, r) = p->dispatchTime;
+            cell<unsigned int>(CC_COMPLETED, r) = p->completionTime;
+            cell<unsigned int>(CC_UPDATED, r) = p->lastUpdateTime;
+            cell<unsigned int>(CC_EVENT_START, r) = (unsigned int)ev;
+            cell<unsigned short>(CC_DURATION, r) = p->estimatedDurationSec;
+            cell<unsigned short>(CC_DISTANCE, r) = p->totalDistanceKm;
+            cell<short>(CC_SRC_CITY, r) = p->sourceCityID;
+            cell<short>(CC_DST_CITY, r) = p->destCityID;
+            if (!names.store(p->sourceNameId, cell<unsigned short>(CC_SRC_NAME, r)) ||
+                !names.store(p->destNameId, cell<unsigned short>(CC_DST_NAME, r)) ||
+                !routes.store(p->routeId, cell<unsigned short>(CC_ROUTE, r)) ||
+                !names.store(p->riderNameId, cell<unsigned short>(CC_RIDER_NAME, r))) return false;
+            cell<unsigned short>(CC_EVENT_COUNT, r) = p->historyCount;
+            cell<unsigned char>(CC_STATUS, r) = p->status;
+            cell<unsigned char>(CC_PRIORITY, r) = p->priorityLevel;
+            cell<unsigned char>(CC_FLAGS, r) = (p->isReturning ? 1 : 0) | (p->willFailOnPath ? 2 : 0);
+            cell<signed char>(CC_RIDER_SLOT, r) = p->indexedRider;
+
+            int seen = 0;
+            EventChunk* c = p->historyTail ? p->historyTail->next : nullptr;
+            while (seen < p->historyCount) {
+                for (int k = 0; k < EVENT_CHUNK_CAPACITY && seen < p->historyCount; k++, seen++) {
+                    ParcelEvent e = c->events[k];
+                    if (e.code == EV_DISPATCHED && !names.store(e.arg, e.arg)) return false;
+                    if (e.code == EV_ROUTE_ASSIGNED && !routes.store(e.arg, e.arg)) return false;
+                    events()[ev++] = e;
+                }
+                c = c->next;
+            }
+            if (p->id > maxId) maxId = p->id;
+        }
+        stagedRow0 = row0;
+        stagedRows = n;
+        stagedEventEnd = ev;
+        stagedMaxId = maxId;
+        return true;
+    }
+
+    // Touches nothing readers use, so the caller may release engineMutex meanwhile
+    void syncStaged() {
+        if (stagedRows == 0) return;
+        long long event0 = header()->eventCount;
+        names.sync();
+        routes.sync();
+        eventsFile.sync((size_t)event0 * sizeof(ParcelEvent), (size_t)stagedEventEnd * sizeof(ParcelEvent));
+        rowsFile.sync(rowsEnd(stagedRow0) - (stagedRow0 % COLD_BLOCK_ROWS ? blockBytes : 0), rowsEnd(stagedRow0 + stagedRows));
+    }
+
+    void publishStaged() {
+        if (stagedRows == 0) return;
+        long long rows = stagedRow0 + stagedRows;
+        header()->eventCount = stagedEventEnd;
+        header()->maxId = stagedMaxId;
+        header()->rowCount = rows;
+        rowsFile.sync(0, COLD_HEADER_BYTES);
+
+        for (long long r = stagedRow0; r < rows; r++) indexInsert(cell<int>(CC_ID, r), r);
+        indexHeader()->indexedRows = rows;
+        stagedRows = 0;
+        flushCount++;
+    }
+
+    long long findRow(int id) {
+        if (!isOpen()) return -1;
+        ColdIndexHeader* h = indexHeader();
+        ColdIndexSlot* slots = indexSlots();
+        unsigned int mask = (unsigned int)(h->capacity - 1);
+        unsigned int i = slotFor(id, h->capacity);
+        while (slots[i].rowPlusOne != 0) {
+            if (slots[i].id == id) return (long long)slots[i].rowPlusOne - 1;
+            i = (i + 1) & mask;
+        }
+        return -1;
+    }
+
+    bool contains(int id) { return findRow(id) >= 0; }
+
+    // Fills the scalar fields of p from a row (no history)
+    void readSummary(long long r, Parcel& p) {
+        p.id = cell<int>(CC_ID, r);
+        p.weightGrams = cell<unsigned int>(CC_WEIGHT, r);
+        p.costPaisa = cell<unsigned int>(CC_COST, r);
+        p.creationTime = cell<unsigned int>(CC_CREATED, r);
+        p.dispatchTime = cell<unsigned int>(CC_DISPATCHED, r);
+        p.completionTime = cell<unsigned int>(CC_COMPLETED, r);
+        p.lastUpdateTime = cell<unsigned int>(CC_UPDATED, r);
+        p.estimatedDurationSec = cell<unsigned short>(CC_DURATION, r);
+        p.totalDistanceKm = cell<unsigned short>(CC_DISTANCE, r);
+        p.sourceCityID = cell<short>(CC_SRC_CITY, r);
+        p.destCityID = cell<short>(CC_DST_CITY, r);
+        p.sourceNameId = names.fromColdId(cell<unsigned short>(CC_SRC_NAME, r));
+        p.destNameId = names.fromColdId(cell<unsigned short>(CC_DST_NAME, r));
+        p.routeId = routes.fromColdId(cell<unsigned short>(CC_ROUTE, r));
+        p.riderNameId = names.fromColdId(cell<unsigned short>(CC_RIDER_NAME, r));
+        p.status = cell<unsigned char>(CC_STATUS, r);
+        p.priorityLevel = cell<unsigned char>(CC_PRIORITY, r);
+        p.isReturning = (cell<unsigned char>(CC_FLAGS, r) & 1) != 0;
+        p.willFailOnPath = (cell<unsigned char>(CC_FLAGS, r) & 2) != 0;
+        p.indexedRider = cell<signed char>(CC_RIDER_SLOT, r);
+    }
+
+    // Materialises a row as a temporary Parcel, history included. Caller deletes it.
+    Parcel* loadRow(long long r) {
+        Parcel* p = new Parcel(cell<int>(CC_ID, r));
+        readSummary(r, *p);
+        unsigned int start = cell<unsigned int>(CC_EVENT_START, r);
+        unsigned short n = cell<unsigned short>(CC_EVENT_COUNT, r);
+        for (unsigned int k = 0; k < n; k++) {
+            ParcelEvent e = events()[start + k];
+            if (e.code == EV_DISPATCHED) e.arg = names.fromColdId(e.arg);
+            else if (e.code == EV_ROUTE_ASSIGNED) e.arg = routes.fromColdId(e.arg);
+            p->appendEvent(e);
+        }
+        return p;
+    }
+
+    Parcel* load(int id) {
+        long long r = findRow(id);
+        return r >= 0 ? loadRow(r) : nullptr;
+    }
+
+    // First row completed at or after t (rows are in completion-time order)
+    long long firstRowCompletedAt(time_t t) {
+        long long lo = 0, hi = size();
+        ParcelTime key = t > PARCEL_EPOCH ? toParcelTime(t) : 0;
+        while (lo < hi) {
+            long long mid = (lo + hi) / 2;
+            if (cell<unsigned int>(CC_COMPLETED, mid) < key) lo = mid + 1;
+            else hi = mid;
+        }
+        return lo;
+    }
+
+    // Smallest archived ID >= fromId, or -1 (binary search of sortedIds)
+    int nextIdAtLeast(int fromId) {
+        if (!isOpen()) return -1;
+        catchUpSortedIds();
+        long long lo = 0, hi = sortedCount;
+        while (lo < hi) {
+            long long mid = (lo + hi) / 2;
+            if (sortedIds[mid] < fromId) lo = mid + 1;
+            else hi = mid;
+        }
+        return lo < sortedCount ? sortedIds[lo] : -1;
+    }
+
+    // Adds the cold rows to a per-status breakdown, one column block at a time
+    void aggregateByStatus(long long counts[ST_COUNT], long long paisa[ST_COUNT], long long grams[ST_COUNT]) {
+        long long rows = size();
+        for (long long base = 0; base < rows; base += COLD_BLOCK_ROWS) {
+            int n = (int)min((long long)COLD_BLOCK_ROWS, rows - base);
+            const unsigned char* status = &cell<unsigned char>(CC_STATUS, base);
+            const unsigned int* cost = &cell<unsigned int>(CC_COST, base);
+            const unsigned int* weight = &cell<unsigned int>(CC_WEIGHT, base);
+            for (int i = 0; i < n; i++) {
+                int k = status[i] < ST_COUNT ? status[i] : (unsigned char)ST_MISSING;
+                counts[k]++;
+                paisa[k] += cost[i];
+                grams[k] += weight[i];
+            }
+        }
+    }
+};
+
+// --- 4.14 PARCEL ID REGISTRY ---
+// One bit per booking ID. A counter claims its ID with a single atomic fetch_or
+// before any engine lock is taken, so concurrent registrations can never hand
+// out the same ID, whichever shard or batch ends up committing them.
+class ParcelIdRegistry {
+private:
+    static const int WORDS = MAX_PARCEL_ID / 64 + 1;
+    atomic<unsigned long long> words[WORDS];
+
+public:
+    ParcelIdRegistry() {
+        for (int i = 0; i < WORDS; i++) words[i].store(0, memory_order_relaxed);
+    }
+
+    // True if the caller now owns the ID (false: taken, or out of range)
+    bool claim(int id) {
+        if (id <= 0 || id > MAX_PARCEL_ID) return false;
+        unsigned long long bit = 1ULL << (id & 63);
+        return (words[id >> 6].fetch_or(bit, memory_order_acq_rel) & bit) == 0;
+    }
+
+    void release(int id) {
+        if (id <= 0 || id > MAX_PARCEL_ID) return;
+        words[id >> 6].fetch_and(~(1ULL << (id & 63)), memory_order_acq_rel);
+    }
+
+    bool isClaimed(int id) {
+        if (id <= 0 || id > MAX_PARCEL_ID) return false;
+        return (words[id >> 6].load(memory_order_acquire) >> (id & 63)) & 1;
+    }
+};
+
+// ==========================================
+// 5. GRAPH MODULE (ROUTING)
+// ==========================================
+
+// --- TIME-OF-DAY TRAVEL PROFILES ---
+// A profile scales a road's travel time over the day: breakpoints of (minute of
+// day, factor) joined by straight lines and wrapping at midnight, e.g. 1.0 at
+// night rising to 1.8 at 08:30. Roads reference profiles by ID, and identical
+// profiles are stored once, so a thousand city roads with the same rush-hour
+// pattern cost one set of breakpoints. Profile 0 is flat (no rush hour).
+struct ProfilePoint {
+    unsigned short minuteOfDay;   // 0-1439, ascending within a profile
+    unsigned short factor;        // Travel-time multiplier in 1/1000
+};
+
+class TravelProfileTable {
+private:
+    struct Profile {
+        int first;            // Index of the first breakpoint in points[]
+        int count;
+        unsigned int hash;
+    };
+    ProfilePoint points[MAX_PROFILE_POINTS];
+    Profile profiles[MAX_TRAVEL_PROFILES];
+    int profileCount;
+    int pointCount;
+
+    static unsigned int hashOf(const ProfilePoint* pts, int n) {
+        unsigned int h = 2166136261u;
+        for (int i = 0; i < n; i++) {
+            h = (h ^ pts[i].minuteOfDay) * 16777619u;
+            h = (h ^ pts[i].factor) * 16777619u;
+        }
+        return h;
+    }
+
+public:
+    TravelProfileTable() : profileCount(0), pointCount(0) {
+        ProfilePoint flat = {0, 1000};
+        intern(&flat, 1);
+    }
+
+    // Start-up only. Returns the ID of an identical existing profile or of a new
+    // one; -1 if the points are out of order or the table is full.
+    int intern(const ProfilePoint* pts, int n) {
+        if (n < 1) return -1;
+        for (int i = 0; i < n; i++) {
+            if (pts[i].minuteOfDay >= 24 * 60 || pts[i].factor == 0) return -1;
+            if (i > 0 && pts[i].minuteOfDay <= pts[i - 1].minuteOfDay) return -1;
+        }
+        unsigned int h = hashOf(pts, n);
+        for (int id = 0; id < profileCount; id++) {
+            Profile& p = profiles[id];
+            if (p.hash != h || p.count != n) continue;
+            if (memcmp(points + p.first, pts, n * sizeof(ProfilePoint)) == 0) return id;
+        }
+        if (profileCount == MAX_TRAVEL_PROFILES || pointCount + n > MAX_PROFILE_POINTS) return -1;
+        Profile& p = profiles[profileCount];
+        p.first = pointCount;
+        p.count = n;
+        p.hash = h;
+        memcpy(points + pointCount, pts, n * sizeof(ProfilePoint));
+        pointCount += n;
+        return profileCount++;
+    }
+
+    // Multiplier (1/1000) at a second of the day, interpolated between breakpoints
+    int factorAt(int id, int secondOfDay) const {
+        const Profile& p = profiles[(id >= 0 && id < profileCount) ? id : 0];
+        const ProfilePoint* pts = points + p.first;
+        if (p.count == 1) return pts[0].factor;
+
+        int i = 0;
+        while (i < p.count && pts[i].minuteOfDay * 60 <= secondOfDay) i++;
+        // Segment from the breakpoint before secondOfDay to the one after, across midnight if needed
+        const ProfilePoint& a = pts[(i + p.count - 1) % p.count];
+        const ProfilePoint& b = pts[i % p.count];
+        int from = a.minuteOfDay * 60, to = b.minuteOfDay * 60;
+        if (to <= from) to += 24 * 3600;
+        int at = secondOfDay < from ? secondOfDay + 24 * 3600 : secondOfDay;
+        return a.factor + (int)((long long)(b.factor - a.factor) * (at - from) / (to - from));
+    }
+
+    // Seconds from secondOfDay to the next breakpoint (wrapping at midnight); 0 for a flat profile
+    int secondsToNextBreak(int id, int secondOfDay) const {
+        const Profile& p = profiles[(id >= 0 && id < profileCount) ? id : 0];
+        const ProfilePoint* pts = points + p.first;
+        if (p.count == 1) return 0;
+        for (int i = 0; i < p.count; i++) {
+            if (pts[i].minuteOfDay * 60 > secondOfDay) return pts[i].minuteOfDay * 60 - secondOfDay;
+        }
+        return pts[0].minuteOfDay * 60 + 24 * 3600 - secondOfDay;
+    }
+
+    int count() const { return profileCount; }
+    int pointsUsed() const { return pointCount; }
+};
+
+// Topology only: a road's live state (weight, traffic, block) is kept in the
+// current RoadSnapshot under its roadId, shared by both directions. The travel
+// profile belongs to the direction, so inbound and outbound rush hours can differ.
+struct Edge {
+    int destCityID;
+    int baseDistance; 
+    int roadId;
+    int profileId;
+
+    Edge(int d, int w, int id, int profile = 0) : destCityID(d), baseDistance(w), roadId(id), profileId(profile) {}
+};
+
+struct EdgeNode {
+    Edge data;
+    EdgeNode* next;
+    EdgeNode(Edge val) : data(val), next(nullptr) {}
+
+    static FixedBlockPool& pool() {
+        static FixedBlockPool* parked = nullptr;
+        static thread_local PoolHandle p(parked, sizeof(EdgeNode), POOL_SLAB_BLOCKS);
+        return p.get();
+    }
+    static void* operator new(size_t) { return pool().allocate(); }
+    static void operator delete(void* ptr) { pool().release(ptr); }
+};
+
+class EdgeList {
+public:
+    EdgeNode* head;
+    EdgeList() : head(nullptr) {}
+    
+    void pushBack(Edge val) {
+        EdgeNode* n = new EdgeNode(val);
+        if(!head) head = n;
+        else {
+            EdgeNode* temp = head;
+            while(temp->next) temp = temp->next;
+            temp->next = n;
+        }
+    }
+};
+
+struct PathInfo {
+    int totalDist;
+    int travelSec;          // Time-dependent travel time from the query's departure
+    int settledNodes;       // Cities the search finalised (routing cost)
+    string pathDescription;
+    short cityPath[MAX_CITIES]; // Graph city ids from source to destination
+    int cityCount;              // 0 when there is no path
+    bool isValid;
+    bool isBlocked;
+    bool containsTraffic;
+};
+
+enum RouteSearchMode {
+    ROUTE_DIJKSTRA,       // Plain label-setting search from the source
+    ROUTE_ASTAR,          // A* guided by landmark and straight-line lower bounds
+    ROUTE_BIDIRECTIONAL   // Dijkstra from both ends, stopping when the frontiers meet
+};
+
+// Min-heap of cities keyed by tentative cost, with decrease-key. Every city sits
+// in it at most once, so it fits in fixed arrays on the stack.
+struct CityHeap {
+    int key[MAX_CITIES];
+    int heap[MAX_CITIES];
+    int pos[MAX_CITIES];     // Index in heap[], -1 if absent
+    int size;
+
+    CityHeap() : size(0) {
+        for (int i = 0; i < MAX_CITIES; i++) pos[i] = -1;
+    }
+
+    bool isEmpty() const { return size == 0; }
+
+    void pushOrDecrease(int city, int k) {
+        int i = pos[city];
+        if (i < 0) {
+            i = size++;
+            heap[i] = city;
+            pos[city] = i;
+        } else if (k >= key[city]) {
+            return;
+        }
+        key[city] = k;
+        while (i > 0 && key[heap[(i - 1) / 2]] > k) {
+            swapAt(i, (i - 1) / 2);
+            i = (i - 1) / 2;
+        }
+    }
+
+    int popMin() {
+        int top = heap[0];
+        swapAt(0, --size);
+        pos[top] = -1;
+        int i = 0;
+        while (true) {
+            int l = 2 * i + 1, r = l + 1, m = i;
+            if (l < size && key[heap[l]] < key[heap[m]]) m = l;
+            if (r < size && key[heap[r]] < key[heap[m]]) m = r;
+            if (m == i) break;
+            swapAt(i, m);
+            i = m;
+        }
+        return top;
+    }
+
+private:
+    void swapAt(int a, int b) {
+        int t = heap[a];
+        heap[a] = heap[b];
+        heap[b] = t;
+        pos[heap[a]] = a;
+        pos[heap[b]] = b;
+    }
+};
+
+// S x T road distances in one row-major block: at(i, j) is source i to target j
+// (INT_MAX if unreachable). All cells come from the same network version.
+struct DistanceTable {
+    int sourceCount;
+    int targetCount;
+    long long version;
+    int* cells;
+
+    DistanceTable(int s, int t) : sourceCount(s), targetCount(t), version(0), cells(new int[s * t > 0 ? s * t : 1]) {}
+    ~DistanceTable() { delete[] cells; }
+
+    int at(int i, int j) const { return cells[i * targetCount + j]; }
+
+    DistanceTable(const DistanceTable&) = delete;
+    DistanceTable& operator=(const DistanceTable&) = delete;
+};
+
+// Fee components of a booking (shown in the cost breakdown)
+struct ParcelQuote {
+    double baseFee;
+    double weightFee;
+    double priorityFee;
+    double distanceFee;
+};
+
+// String Stack
+struct StringNode {
+    string data;
+    StringNode* next;
+    StringNode(string val) : data(val), next(nullptr) {}
+};
+
+class StringStack {
+private:
+    StringNode* top;
+    ScratchArena* arena; // When set, nodes live in the arena instead of the heap
+public:
+    StringStack(ScratchArena* a = nullptr) : top(nullptr), arena(a) {}
+    ~StringStack() { while(!isEmpty()) pop(); }
+    void push(string val) {
+        StringNode* n = arena ? new (arena->allocate(sizeof(StringNode))) StringNode(val) : new StringNode(val);
+        n->next = top;
+        top = n;
+    }
+    string pop() {
+        if(!top) return "";
+        StringNode* temp = top;
+        string val = temp->data;
+        top = top->next;
+        if (arena) temp->~StringNode();
+        else delete temp;
+        return val;
+    }
+    bool isEmpty() { return top == nullptr; }
+};
+
+// Why applyRoadUpdates turned a road update down
+enum RoadReject {
+    ROAD_APPLIED,
+    ROAD_NO_SUCH_ROAD,
+    ROAD_BAD_STATUS,
+    ROAD_BAD_FACTOR,
+    ROAD_REJECT_COUNT
+};
+
+const string ROAD_REJECT_REASONS[ROAD_REJECT_COUNT] = {
+    "applied", "no direct road", "status must be 1, 2 or 3", "traffic multiplier out of range"
+};
+
+// One road change from the admin panel or a traffic feed. A feed line reads
+// "<u> <v> <status>" (1 normal, 2 traffic, 3 blocked) or "<u> <v> x<multiplier>",
+// e.g. "4 7 x1.8" for a road running 80% slower than free flow.
+struct RoadUpdate {
+    int u, v;
+    int status;
+    int factor;         // Weight multiplier in 1/1000 (1000 = free flow)
+    int beforeStatus;   // Filled in when the update is applied
+    int beforeFactor;
+    bool applied;
+    RoadReject reject;  // ROAD_APPLIED, or why the update was turned down
+
+    RoadUpdate() : u(0), v(0), status(1), factor(1000), beforeStatus(0), beforeFactor(0), applied(false), reject(ROAD_APPLIED) {}
+    RoadUpdate(int a, int b, int s) : u(a), v(b), status(s), factor(s == 2 ? TRAFFIC_FACTOR_DEFAULT : 1000),
+                                      beforeStatus(0), beforeFactor(0), applied(false), reject(ROAD_APPLIED) {}
+
+    static bool parse(const string& text, RoadUpdate& out) {
+        istringstream in(text);
+        string level, extra;
+        if (!(in >> out.u >> out.v >> level) || (in >> extra)) return false;
+        if (level == "1" || level == "2" || level == "3") {
+            out = RoadUpdate(out.u, out.v, level[0] - '0');
+            return true;
+        }
+        if (level.size() < 2 || (level[0] != 'x' && level[0] != 'X')) return false;
+        char* end = nullptr;
+        double m = strtod(level.c_str() + 1, &end);
+        if (*end != '\0' || !(m >= 1.0) || m * 1000 > TRAFFIC_FACTOR_MAX) return false;
+        out.factor = (int)(m * 1000 + 0.5);
+        out.status = out.factor > 1000 ? 2 : 1;
+        if (out.status == 1) out.factor = 1000;
+        return true;
+    }
+};
+
+// --- ROAD STATE SNAPSHOTS (READ-COPY-UPDATE) ---
+// Roads are fixed after start-up; what changes is their state, which lives in an
+// immutable snapshot indexed by road ID. A route query pins the current snapshot
+// and reads it with no lock at all. A road update copies the snapshot, edits the
+// copy and publishes it with one atomic swap, so a query sees either the old
+// network or the new one, never half an update. A replaced snapshot is freed
+// once every reader that might still hold it has unpinned (epoch-based reclamation).
+struct RoadSnapshot {
+    long long version;      // Bumped on every publish
+    int roadCount;
+    int* weight;            // Routing weight per road (distance x traffic factor)
+    unsigned char* status;  // 1 normal, 2 traffic, 3 blocked
+    unsigned short* factor; // Traffic multiplier in 1/1000 (1000 = free flow)
+    short openComponent[MAX_CITIES];  // Union-find root per city over non-blocked roads (flattened)
+    long long retiredAt;    // Epoch at which a newer snapshot replaced this one
+    RoadSnapshot* nextRetired;
+
+    RoadSnapshot(int roads, long long v)
+        : version(v), roadCount(roads), weight(new int[roads > 0 ? roads : 1]),
+          status(new unsigned char[roads > 0 ? roads : 1]), factor(new unsigned short[roads > 0 ? roads : 1]),
+          retiredAt(0), nextRetired(nullptr) {
+        for (int i = 0; i < MAX_CITIES; i++) openComponent[i] = (short)i;
+    }
+
+    ~RoadSnapshot() {
+        delete[] weight;
+        delete[] status;
+        delete[] factor;
+    }
+
+    // Copy for the next version, with room for `roads` roads (extra slots uninitialised)
+    RoadSnapshot* copy(int roads) const {
+        RoadSnapshot* next = new RoadSnapshot(roads, version + 1);
+        for (int i = 0; i < roadCount && i < roads; i++) {
+            next->weight[i] = weight[i];
+            next->status[i] = status[i];
+            next->factor[i] = factor[i];
+        }
+        for (int i = 0; i < MAX_CITIES; i++) next->openComponent[i] = openComponent[i];
+        return next;
+    }
+
+    RoadSnapshot(const RoadSnapshot&) = delete;
+    RoadSnapshot& operator=(const RoadSnapshot&) = delete;
+};
+
+// Readers announce the epoch they started in; a writer retires a snapshot at the
+// epoch it replaced it and frees it once no reader from that epoch or earlier is left.
+class EpochReclaimer {
+private:
+    struct alignas(64) ReaderSlot {
+        atomic<long long> pinnedEpoch;   // 0 = free
+    };
+    ReaderSlot slots[ROUTE_READER_SLOTS];
+    atomic<long long> epoch;
+
+public:
+    EpochReclaimer() : epoch(1) {
+        for (int i = 0; i < ROUTE_READER_SLOTS; i++) slots[i].pinnedEpoch.store(0);
+    }
+
+    // Lock-free: claims any free slot. Returns the slot to hand back to unpin().
+    int pin() {
+        static thread_local int hint = 0;
+        while (true) {
+            long long e = epoch.load();
+            for (int k = 0; k < ROUTE_READER_SLOTS; k++) {
+                int i = (hint + k) % ROUTE_READER_SLOTS;
+                long long expected = 0;
+                if (slots[i].pinnedEpoch.compare_exchange_strong(expected, e)) {
+                    hint = i;
+                    return i;
+                }
+            }
+            this_thread::yield(); // All slots busy: wait for a query to finish
+        }
+    }
+
+    void unpin(int slot) { slots[slot].pinnedEpoch.store(0, memory_order_release); }
+
+    // Called by a writer right after publishing; returns the retire epoch
+    long long advance() { return epoch.fetch_add(1); }
+
+    // True once no reader pinned at or before `e` is still running
+    bool quiescent(long long e) {
+        for (int i = 0; i < ROUTE_READER_SLOTS; i++) {
+            long long p = slots[i].pinnedEpoch.load();
+            if (p != 0 && p <= e) return false;
+        }
+        return true;
+    }
 };
 
-class ArchiveBST {
-private:
-    ParcelTreeNode* root;
+class LogisticsGraph {
+private:
+    struct CityNode {
+        int id;
+        string name;
+        EdgeList edges;
+        double lat, lon;    // Degrees; both 0 if unknown
+    };
+    
+    CityNode cities[MAX_CITIES];
+    int numCities;
+    int roadCount;
+    TravelProfileTable profiles;
+
+    // --- A* LOWER BOUNDS ---
+    // Landmarks (ALT): exact base-distance tables from a few far-apart cities.
+    // By the triangle inequality |d(L,t) - d(L,v)| never exceeds the road distance
+    // from v to t. Live weights only ever grow past the base distance (traffic) or
+    // keep it (blocked), so the tables stay valid through every road update and
+    // only a topology change needs a rebuild. The straight-line distance, scaled by
+    // the tightest road-to-crow-flies ratio, adds a second bound for free.
+    int landmarkCount;
+    int landmarks[ALT_LANDMARK_COUNT];
+    int landmarkDist[ALT_LANDMARK_COUNT][MAX_CITIES];  // INT_MAX = unreachable
+    double geoScale;    // 0 disables the straight-line bound
+
+    static double crowFliesKm(const CityNode& a, const CityNode& b) {
+        const double rad = 3.14159265358979 / 180.0;
+        double dLat = (b.lat - a.lat) * rad, dLon = (b.lon - a.lon) * rad;
+        double h = sin(dLat / 2) * sin(dLat / 2) + cos(a.lat * rad) * cos(b.lat * rad) * sin(dLon / 2) * sin(dLon / 2);
+        return 2 * 6371.0 * asin(sqrt(min(1.0, h)));
+    }
+
+    bool hasCoordinates(int c) const { return cities[c].lat != 0 || cities[c].lon != 0; }
+
+    // Admissible and consistent estimate of the remaining distance from v to t
+    int lowerBound(int v, int t) const {
+        int best = 0;
+        if (geoScale > 0 && hasCoordinates(v) && hasCoordinates(t)) best = (int)(crowFliesKm(cities[v], cities[t]) * geoScale);
+        for (int i = 0; i < landmarkCount; i++) {
+            int a = landmarkDist[i][v], b = landmarkDist[i][t];
+            if (a == INT_MAX || b == INT_MAX) continue;
+            best = max(best, a > b ? a - b : b - a);
+        }
+        return best;
+    }
+
+    static bool isRestrictedEdge(int u, int v, int avoidU, int avoidV) {
+        return (u == avoidU && v == avoidV) || (u == avoidV && v == avoidU);
+    }
+
+    // Settles cities in distance order until the target is settled. Returns the number settled.
+    int searchDijkstra(const RoadSnapshot* snap, int start, int end, int avoidEdgeU, int avoidEdgeV, int* dist, int* parent) {
+        bool visited[MAX_CITIES];
+
+        for (int i = 0; i < MAX_CITIES; i++) {
+            dist[i] = INT_MAX;
+            visited[i] = false;
+            parent[i] = -1;
+        }
+
+        dist[start] = 0;
+        int settled = 0;
+
+        for (int count = 0; count < numCities; count++) {
+            int u = -1, minVal = INT_MAX;
+            for (int i = 0; i < numCities; i++) {
+                if (cities[i].name != "" && !visited[i] && dist[i] < minVal) {
+                    minVal = dist[i];
+                    u = i;
+                }
+            }
+
+            if (u == -1 || dist[u] == INT_MAX) break; 
+            visited[u] = true;
+            settled++;
+            if (u == end) break;   // Final once settled; the rest of the sweep cannot improve it
 
-    void insertRec(ParcelTreeNode*& node, Parcel* p) {
-        if (!node) {
-            node = new ParcelTreeNode(p);
-            return;
+            EdgeNode* curr = cities[u].edges.head;
+            while (curr) {
+                int v = curr->data.destCityID;
+                if (!isRestrictedEdge(u, v, avoidEdgeU, avoidEdgeV)) {
+                    int weight = snap->weight[curr->data.roadId];
+                    if (!visited[v] && dist[u] + weight < dist[v]) {
+                        dist[v] = dist[u] + weight;
+                        parent[v] = u;
+                    }
+                }
+                curr = curr->next;
+            }
         }
-        if (p->id < node->data->id) insertRec(node->left, p);
-        else if (p->id > node->data->id) insertRec(node->right, p);
+        return settled;
     }
 
-    void inOrderRec(ParcelTreeNode* node) {
-        if (!node) return;
-        inOrderRec(node->left);
-        node->data->displayTableRow();
-        inOrderRec(node->right);
+    // A*: expands cities in order of distance-so-far plus lower bound and stops
+    // once the target is settled. The bound is consistent, so a settled city is
+    // final and dist[end] equals the Dijkstra result.
+    int searchAStar(const RoadSnapshot* snap, int start, int end, int avoidEdgeU, int avoidEdgeV, int* dist, int* parent) {
+        bool closed[MAX_CITIES];
+        for (int i = 0; i < MAX_CITIES; i++) {
+            dist[i] = INT_MAX;
+            closed[i] = false;
+            parent[i] = -1;
+        }
+
+        CityHeap open;
+        dist[start] = 0;
+        open.pushOrDecrease(start, lowerBound(start, end));
+        int settled = 0;
+        while (!open.isEmpty()) {
+            int u = open.popMin();
+            closed[u] = true;
+            settled++;
+            if (u == end) break;
+
+            for (EdgeNode* e = cities[u].edges.head; e; e = e->next) {
+                int v = e->data.destCityID;
+                if (closed[v] || isRestrictedEdge(u, v, avoidEdgeU, avoidEdgeV)) continue;
+                int candidate = dist[u] + snap->weight[e->data.roadId];
+                if (candidate < dist[v]) {
+                    dist[v] = candidate;
+                    parent[v] = u;
+                    open.pushOrDecrease(v, candidate + lowerBound(v, end));
+                }
+            }
+        }
+        return settled;
     }
 
-public:
-    ArchiveBST() : root(nullptr) {}
-    void insert(Parcel* p) { insertRec(root, p); }
-    void displayInOrder() { 
-        if (!root) { cout << YELLOW << "    (History Archive is Empty)" << RESET << endl; return; }
-        cout << BLUE << " | " << setw(5) << "ID" 
-             << " | " << setw(12) << "SOURCE" 
-             << " | " << setw(12) << "DEST"
-             << " | " << setw(6) << "WGT"
-             << " | " << setw(5) << "PRI"
-             << " | " << setw(25) << "FINAL STATUS"
-             << " | " << setw(8) << "RIDER"
-             << " | " << RESET << endl;
-        UIHelper::printLine();
-        inOrderRec(root); 
+    // Alternates one settle from each side (roads are two-way, so the backward
+    // search walks the same edges). Every edge relaxed between the two trees is a
+    // candidate meeting point; once the two frontier minima add up to at least the
+    // best candidate no shorter path can remain. The result is written as a single
+    // parent chain ending at `end`, as the one-sided searches produce.
+    int searchBidirectional(const RoadSnapshot* snap, int start, int end, int avoidEdgeU, int avoidEdgeV, int* dist, int* parent) {
+        int distB[MAX_CITIES];
+        int parentB[MAX_CITIES];   // Next city towards `end`
+        bool doneF[MAX_CITIES], doneB[MAX_CITIES];
+        for (int i = 0; i < MAX_CITIES; i++) {
+            dist[i] = distB[i] = INT_MAX;
+            parent[i] = parentB[i] = -1;
+            doneF[i] = doneB[i] = false;
+        }
+
+        CityHeap forward, backward;
+        dist[start] = 0;
+        distB[end] = 0;
+        forward.pushOrDecrease(start, 0);
+        backward.pushOrDecrease(end, 0);
+        int best = start == end ? 0 : INT_MAX;
+        int meet = start == end ? start : -1;
+        int settled = 0;
+
+        while (!forward.isEmpty() && !backward.isEmpty()) {
+            int topF = forward.key[forward.heap[0]], topB = backward.key[backward.heap[0]];
+            if (best != INT_MAX && (long long)topF + topB >= best) break;
+
+            // Grow the smaller frontier
+            bool goForward = topF <= topB;
+            CityHeap& open = goForward ? forward : backward;
+            int* d = goForward ? dist : distB;
+            int* link = goForward ? parent : parentB;
+            bool* done = goForward ? doneF : doneB;
+            const int* other = goForward ? distB : dist;
+
+            int u = open.popMin();
+            done[u] = true;
+            settled++;
+            for (EdgeNode* e = cities[u].edges.head; e; e = e->next) {
+                int v = e->data.destCityID;
+                if (done[v] || isRestrictedEdge(u, v, avoidEdgeU, avoidEdgeV)) continue;
+                int candidate = d[u] + snap->weight[e->data.roadId];
+                if (candidate < d[v]) {
+                    d[v] = candidate;
+                    link[v] = u;
+                    open.pushOrDecrease(v, candidate);
+                }
+                if (other[v] != INT_MAX && (long long)d[v] + other[v] < best) {
+                    best = d[v] + other[v];
+                    meet = v;
+                }
+            }
+        }
+
+        if (meet < 0) {
+            dist[end] = INT_MAX;
+            return settled;
+        }
+        for (int x = meet; x != end; x = parentB[x]) parent[parentB[x]] = x;
+        dist[end] = best;
+        return settled;
     }
-};
 
-// ==========================================
-// 5. GRAPH MODULE (ROUTING)
-// ==========================================
+    // One-to-all Dijkstra: live weights of `snap`, or base distances when snap is null
+    void distancesFrom(const RoadSnapshot* snap, int source, int* dist) {
+        CityHeap open;
+        for (int i = 0; i < MAX_CITIES; i++) dist[i] = INT_MAX;
+        dist[source] = 0;
+        open.pushOrDecrease(source, 0);
+        while (!open.isEmpty()) {
+            int u = open.popMin();
+            for (EdgeNode* e = cities[u].edges.head; e; e = e->next) {
+                int v = e->data.destCityID;
+                int weight = snap ? snap->weight[e->data.roadId] : e->data.baseDistance;
+                if (dist[u] + weight < dist[v]) {
+                    dist[v] = dist[u] + weight;
+                    open.pushOrDecrease(v, dist[v]);
+                }
+            }
+        }
+    }
 
-struct Edge {
-    int destCityID;
-    int weight;       
-    int baseDistance; 
-    bool isBlocked;   
-    bool hasTraffic;
+    // --- CONNECTIVITY INDEX ---
+    // Union-find answers "is there any route at all?" without a search. Two
+    // partitions are kept: the whole road network (fixed after start-up) and the
+    // open network without blocked roads (per snapshot, so readers see the one
+    // that matches their weights). Opening a road is a union on the copied labels;
+    // blocking one can split a component, which union-find cannot undo, so the
+    // open partition is rebuilt from the remaining roads. Labels are flattened to
+    // roots before publishing, so a lookup is a single array read.
+    short topoComponent[MAX_CITIES];
+
+    static int findRoot(short* parent, int x) {
+        while (parent[x] != x) {
+            parent[x] = parent[parent[x]];
+            x = parent[x];
+        }
+        return x;
+    }
 
-    Edge(int d, int w) : destCityID(d), weight(w), baseDistance(w), isBlocked(false), hasTraffic(false) {}
-};
+    static void unite(short* parent, int a, int b) {
+        int ra = findRoot(parent, a), rb = findRoot(parent, b);
+        if (ra != rb) parent[max(ra, rb)] = (short)min(ra, rb);
+    }
 
-struct EdgeNode {
-    Edge data;
-    EdgeNode* next;
-    EdgeNode(Edge val) : data(val), next(nullptr) {}
-};
+    static void flatten(short* parent) {
+        for (int i = 0; i < MAX_CITIES; i++) parent[i] = (short)findRoot(parent, i);
+    }
 
-class EdgeList {
-public:
-    EdgeNode* head;
-    EdgeList() : head(nullptr) {}
-    
-    void pushBack(Edge val) {
-        EdgeNode* n = new EdgeNode(val);
-        if(!head) head = n;
-        else {
-            EdgeNode* temp = head;
-            while(temp->next) temp = temp->next;
-            temp->next = n;
+    // Caller holds writerMutex; `snap` is the unpublished copy
+    void rebuildOpenComponents(RoadSnapshot* snap) {
+        for (int i = 0; i < MAX_CITIES; i++) snap->openComponent[i] = (short)i;
+        for (int u = 0; u < numCities; u++) {
+            for (EdgeNode* e = cities[u].edges.head; e; e = e->next) {
+                if (e->data.destCityID > u && snap->status[e->data.roadId] != 3) unite(snap->openComponent, u, e->data.destCityID);
+            }
         }
+        flatten(snap->openComponent);
     }
-};
 
-struct PathInfo {
-    int totalDist;
-    string pathDescription;
-    bool isValid;
-    bool isBlocked;
-    bool containsTraffic;
-};
+    // --- MANY-TO-MANY DISTANCE ROWS ---
+    // One-to-all rows by source city for a single network version. Any S x T
+    // table is cut from these rows, so a dispatch pass, a tour plan and a batch
+    // of quotes on the same network share one sweep per source. A publish makes
+    // the next table request start over.
+    struct DistanceRowCache {
+        long long version;
+        bool ready[MAX_CITIES];
+        int rows[MAX_CITIES][MAX_CITIES];
+    };
+    DistanceRowCache* rowCache;
+    mutex rowCacheMutex;
+    long long rowSweeps;
+    long long rowHits;
+
+    atomic<RoadSnapshot*> current;   // What every new query pins
+    mutex writerMutex;               // Serialises publishers (readers never take it)
+    RoadSnapshot* retired;           // Replaced snapshots waiting for their readers
+    EpochReclaimer readers;
+
+    // Swaps in a finished copy and frees whatever no reader can still see.
+    // Caller holds writerMutex.
+    void publish(RoadSnapshot* next) {
+        RoadSnapshot* old = current.exchange(next);
+        old->retiredAt = readers.advance();
+        old->nextRetired = retired;
+        retired = old;
+
+        RoadSnapshot** link = &retired;
+        while (*link) {
+            if (readers.quiescent((*link)->retiredAt)) {
+                RoadSnapshot* dead = *link;
+                *link = dead->nextRetired;
+                delete dead;
+            } else {
+                link = &(*link)->nextRetired;
+            }
+        }
+    }
 
-// String Stack
-struct StringNode {
-    string data;
-    StringNode* next;
-    StringNode(string val) : data(val), next(nullptr) {}
-};
+    // Blocked roads keep their distance: routes over them are flagged, not avoided
+    static int weightFor(int baseDistance, int status, int factor) {
+        return status == 2 ? (int)((long long)baseDistance * factor / 1000) : baseDistance;
+    }
 
-class StringStack {
-private:
-    StringNode* top;
-public:
-    StringStack() : top(nullptr) {}
-    void push(string val) {
-        StringNode* n = new StringNode(val);
-        n->next = top;
-        top = n;
+    int baseDistanceOf(int u, int roadId) {
+        for (EdgeNode* e = cities[u].edges.head; e; e = e->next) {
+            if (e->data.roadId == roadId) return e->data.baseDistance;
+        }
+        return 0;
     }
-    string pop() {
-        if(!top) return "";
-        StringNode* temp = top;
-        string val = temp->data;
-        top = top->next;
-        delete temp;
-        return val;
+
+    // Road ID of the direct road u-v, or -1
+    int findRoad(int u, int v) {
+        if (u < 0 || u >= numCities) return -1;
+        for (EdgeNode* e = cities[u].edges.head; e; e = e->next) {
+            if (e->data.destCityID == v) return e->data.roadId;
+        }
+        return -1;
     }
-    bool isEmpty() { return top == nullptr; }
-};
 
-class LogisticsGraph {
-private:
-    struct CityNode {
-        int id;
-        string name;
-        EdgeList edges;
+    // Seconds since local midnight
+    static int secondOfDay(time_t t) {
+        tm local;
+        localtime_r(&t, &local);
+        return local.tm_hour * 3600 + local.tm_min * 60 + local.tm_sec;
+    }
+
+    // Seconds to drive one edge entered at second-of-day `tod`. Live traffic and
+    // the time of day multiply.
+    double driveSec(const RoadSnapshot* snap, const Edge& e, long long tod) const {
+        return snap->weight[e.roadId] / (double)SIM_SPEED_KM_PER_SEC * profiles.factorAt(e.profileId, (int)(tod % (24 * 3600))) / 1000.0;
+    }
+
+    // Seconds from reaching one edge, `offset` seconds after a departure made at
+    // second-of-day `departSec`, to leaving it. A steeply falling profile can make
+    // a later entry arrive sooner, so waiting until a later breakpoint counts when
+    // it does: arrival never decreases with entry time (FIFO), which keeps the
+    // time-dependent Dijkstra exact. The arrival curve is linear between
+    // breakpoints, so only the breakpoints before the plain arrival need checking.
+    double edgeTravelSec(const RoadSnapshot* snap, const Edge& e, int departSec, double offset) const {
+        long long enter = departSec + (long long)offset;
+        double best = driveSec(snap, e, enter);
+        long long at = enter;
+        for (;;) {
+            int step = profiles.secondsToNextBreak(e.profileId, (int)(at % (24 * 3600)));
+            if (step == 0) break;
+            at += step;
+            if (at - enter >= best) break;
+            best = min(best, (at - enter) + driveSec(snap, e, at));
+        }
+        return best;
+    }
+
+    // Walks a parent tree from the start to `end`, timing each edge as it is reached
+    int travelSecondsAlong(const RoadSnapshot* snap, const int* parent, int end, time_t departAt) {
+        int route[MAX_CITIES];
+        int hops = 0;
+        for (int c = end; c != -1 && hops < MAX_CITIES; c = parent[c]) route[hops++] = c;
+
+        int departSec = secondOfDay(departAt);
+        double elapsed = 0;
+        for (int i = hops - 1; i > 0; i--) {
+            for (EdgeNode* e = cities[route[i]].edges.head; e; e = e->next) {
+                if (e->data.destCityID != route[i - 1]) continue;
+                elapsed += edgeTravelSec(snap, e->data, departSec, elapsed);
+                break;
+            }
+        }
+        return (int)llround(elapsed);
+    }
+
+    // Fills the city ids, description and traffic/block flags of the path ending at `end`
+    void describePath(const RoadSnapshot* snap, const int* parent, int end, PathInfo& result) {
+        string pathStr = "";
+        int curr = end;
+        int hops = 0;
+        for (int c = end; c != -1; c = parent[c]) hops++;
+        result.cityCount = hops;
+        ScratchArena& scratch = ScratchArena::forThread();
+        ScratchArena::Mark scratchMark = scratch.mark();
+        StringStack pathStack(&scratch);
+        
+        while (curr != -1) {
+            pathStack.push(cities[curr].name);
+            result.cityPath[--hops] = (short)curr;
+            int prev = parent[curr];
+            if (prev != -1) {
+                EdgeNode* edgeNode = cities[prev].edges.head;
+                while(edgeNode) {
+                    if (edgeNode->data.destCityID == curr) {
+                        if (snap->status[edgeNode->data.roadId] == 2) result.containsTraffic = true;
+                        if (snap->status[edgeNode->data.roadId] == 3) result.isBlocked = true;
+                        break;
+                    }
+                    edgeNode = edgeNode->next;
+                }
+            }
+            curr = prev;
+        }
+
+        while(!pathStack.isEmpty()) {
+            pathStr += pathStack.pop();
+            if (!pathStack.isEmpty()) pathStr += " -> ";
+        }
+        scratch.rewind(scratchMark);
+        result.pathDescription = pathStr;
+    }
+
+    // Holds one snapshot for the duration of a query
+    class SnapshotPin {
+    private:
+        LogisticsGraph& graph;
+        int slot;
+        const RoadSnapshot* snap;
+    public:
+        SnapshotPin(LogisticsGraph& g) : graph(g), slot(g.readers.pin()), snap(g.current.load()) {}
+        ~SnapshotPin() { graph.readers.unpin(slot); }
+        const RoadSnapshot* operator->() const { return snap; }
+        const RoadSnapshot* get() const { return snap; }
     };
-    
-    CityNode cities[MAX_CITIES];
-    int numCities;
 
 public:
-    LogisticsGraph() : numCities(0) {}
+    LogisticsGraph() : numCities(0), roadCount(0), landmarkCount(0), geoScale(0),
+                       rowCache(new DistanceRowCache()), rowSweeps(0), rowHits(0),
+                       current(new RoadSnapshot(0, 0)), retired(nullptr) {
+        rowCache->version = -1;
+        for (int i = 0; i < MAX_CITIES; i++) topoComponent[i] = (short)i;
+    }
+
+    ~LogisticsGraph() {
+        delete rowCache;
+        delete current.load();
+        while (retired) {
+            RoadSnapshot* next = retired->nextRetired;
+            delete retired;
+            retired = next;
+        }
+    }
 
-    void addCity(int id, string name) {
+    long long networkVersion() { return current.load()->version; }
+
+    void addCity(int id, string name, double lat = 0, double lon = 0) {
         if (id >= MAX_CITIES) return;
         cities[id].id = id;
         cities[id].name = name;
+        cities[id].lat = lat;
+        cities[id].lon = lon;
         if (id >= numCities) numCities = id + 1;
+        // Parcels and stored routes refer to cities by name id
+        unsigned short nameId = 0;
+        if (!NameTable::intern(name, nameId)) cout << RED << " [!] Name table full: city " << name << " is recorded without a name." << RESET << endl;
+        RouteTable::setCityName(id, nameId);
+    }
+
+    // Start-up only, after the last addRoad. Picks landmarks by farthest-point
+    // selection (each new one as far as possible from those already chosen) and
+    // tabulates their distances. Also fixes the straight-line scale so that no
+    // road is shorter than its scaled crow-flies length.
+    void prepareLandmarks(int wanted = ALT_LANDMARK_COUNT) {
+        geoScale = 1.0;
+        for (int u = 0; u < numCities; u++) {
+            for (EdgeNode* e = cities[u].edges.head; e; e = e->next) {
+                int v = e->data.destCityID;
+                if (!hasCoordinates(u) || !hasCoordinates(v)) continue;
+                double crow = crowFliesKm(cities[u], cities[v]);
+                if (crow > 0) geoScale = min(geoScale, e->data.baseDistance / crow);
+            }
+        }
+
+        landmarkCount = 0;
+        int nearest[MAX_CITIES];   // Distance to the closest chosen landmark
+        for (int i = 0; i < MAX_CITIES; i++) nearest[i] = INT_MAX;
+        int next = -1;
+        for (int i = 0; i < numCities && next < 0; i++) {
+            if (cities[i].name != "") next = i;
+        }
+        while (next >= 0 && landmarkCount < wanted && landmarkCount < ALT_LANDMARK_COUNT) {
+            int* table = landmarkDist[landmarkCount];
+            landmarks[landmarkCount++] = next;
+            distancesFrom(nullptr, next, table);
+            // Unreachable cities count as infinitely far, so other components get landmarks too
+            next = -1;
+            long long farthest = 0;
+            for (int c = 0; c < numCities; c++) {
+                if (cities[c].name == "") continue;
+                nearest[c] = min(nearest[c], table[c]);
+                long long d = nearest[c] == INT_MAX ? LLONG_MAX : nearest[c];
+                if (d > farthest) {
+                    farthest = d;
+                    next = c;
+                }
+            }
+        }
+    }
+
+    int landmarksInUse() { return landmarkCount; }
+
+    // Any route at all, blocked roads included (these are still driven, just flagged)
+    bool connected(int u, int v) {
+        if (u < 0 || u >= MAX_CITIES || v < 0 || v >= MAX_CITIES) return false;
+        return topoComponent[u] == topoComponent[v];
+    }
+
+    // A route that avoids every blocked road
+    bool openlyConnected(int u, int v) {
+        if (!connected(u, v)) return false;
+        SnapshotPin snap(*this);
+        return snap->openComponent[u] == snap->openComponent[v];
     }
 
-    void addRoad(int u, int v, int dist) {
+    // Start-up only, like addRoad
+    int addTravelProfile(const ProfilePoint* pts, int n) { return profiles.intern(pts, n); }
+    int travelProfileCount() { return profiles.count(); }
+    int travelProfilePoints() { return profiles.pointsUsed(); }
+
+    // Start-up only: topology is read without pinning. profileVU < 0 reuses profileUV.
+    void addRoad(int u, int v, int dist, int profileUV = 0, int profileVU = -1) {
         if (u < numCities && v < numCities) {
-            cities[u].edges.pushBack(Edge(v, dist));
-            cities[v].edges.pushBack(Edge(u, dist)); 
+            int id = roadCount++;
+            cities[u].edges.pushBack(Edge(v, dist, id, profileUV));
+            cities[v].edges.pushBack(Edge(u, dist, id, profileVU < 0 ? profileUV : profileVU)); 
+            unite(topoComponent, u, v);
+            flatten(topoComponent);
+
+            lock_guard<mutex> lock(writerMutex);
+            RoadSnapshot* next = current.load()->copy(roadCount);
+            next->weight[id] = dist;
+            next->status[id] = 1;
+            next->factor[id] = 1000;
+            unite(next->openComponent, u, v);
+            flatten(next->openComponent);
+            publish(next);
         }
     }
 
@@ -681,100 +4286,186 @@ public:
         return -1;
     }
 
+    // Shortest by distance; travelSec is timed for a departure now
     PathInfo calculateShortestPath(int start, int end, int avoidEdgeU = -1, int avoidEdgeV = -1) {
+        SnapshotPin snap(*this);
+        return shortestPathIn(snap.get(), start, end, ClockService::now(), avoidEdgeU, avoidEdgeV);
+    }
+
+    PathInfo calculateShortestPath(int start, int end, RouteSearchMode mode) {
+        SnapshotPin snap(*this);
+        return shortestPathIn(snap.get(), start, end, ClockService::now(), -1, -1, mode);
+    }
+
+    // Answer for pairs in different components: no search needed
+    static PathInfo unreachable() {
+        PathInfo result;
+        result.totalDist = INT_MAX;
+        result.travelSec = 0;
+        result.settledNodes = 0;
+        result.cityCount = 0;
+        result.isValid = false;
+        result.isBlocked = false;
+        result.containsTraffic = false;
+        result.pathDescription = "No Path Available";
+        return result;
+    }
+
+    // Point-to-point search over one fixed snapshot
+    PathInfo shortestPathIn(const RoadSnapshot* snap, int start, int end, time_t departAt, int avoidEdgeU = -1, int avoidEdgeV = -1,
+                            RouteSearchMode mode = ROUTE_ASTAR) {
+        if (!connected(start, end)) return unreachable();
+
+        int dist[MAX_CITIES];
+        int parent[MAX_CITIES];
+        int settled = 0;
+        switch (mode) {
+            case ROUTE_DIJKSTRA:      settled = searchDijkstra(snap, start, end, avoidEdgeU, avoidEdgeV, dist, parent); break;
+            case ROUTE_ASTAR:         settled = searchAStar(snap, start, end, avoidEdgeU, avoidEdgeV, dist, parent); break;
+            case ROUTE_BIDIRECTIONAL: settled = searchBidirectional(snap, start, end, avoidEdgeU, avoidEdgeV, dist, parent); break;
+        }
+
+        PathInfo result;
+        result.totalDist = dist[end];
+        result.travelSec = 0;
+        result.settledNodes = settled;
+        result.cityCount = 0;
+        result.isValid = (dist[end] != INT_MAX);
+        result.isBlocked = false;
+        result.containsTraffic = false;
+        
+        if (result.isValid) {
+            describePath(snap, parent, end, result);
+            result.travelSec = travelSecondsAlong(snap, parent, end, departAt);
+            if (result.totalDist >= 999999) result.isBlocked = true; 
+        } else {
+            result.pathDescription = "No Path Available";
+        }
+
+        return result;
+    }
+
+    // Fastest route for a departure at `departAt`: Dijkstra on arrival time, where
+    // each edge costs its travel time at the moment it is entered (time-of-day
+    // profile x live traffic). totalDist is the distance of that route. Blocked
+    // roads are skipped while an open route exists; otherwise the route drives
+    // them and describePath flags it isBlocked.
+    PathInfo calculateFastestPath(int start, int end, time_t departAt) {
+        if (!connected(start, end)) return unreachable();
+        SnapshotPin snap(*this);
+        int departSec = secondOfDay(departAt);
+        bool avoidBlocked = snap->openComponent[start] == snap->openComponent[end];
+        double arrival[MAX_CITIES];
         int dist[MAX_CITIES];
         int parent[MAX_CITIES];
         bool visited[MAX_CITIES];
 
         for (int i = 0; i < MAX_CITIES; i++) {
-            dist[i] = INT_MAX;
+            arrival[i] = -1;
+            dist[i] = 0;
             visited[i] = false;
             parent[i] = -1;
         }
-
-        dist[start] = 0;
+        arrival[start] = 0;
 
         for (int count = 0; count < numCities; count++) {
-            int u = -1, minVal = INT_MAX;
+            int u = -1;
             for (int i = 0; i < numCities; i++) {
-                if (cities[i].name != "" && !visited[i] && dist[i] < minVal) {
-                    minVal = dist[i];
-                    u = i;
-                }
+                if (cities[i].name != "" && !visited[i] && arrival[i] >= 0 && (u == -1 || arrival[i] < arrival[u])) u = i;
             }
-
-            if (u == -1 || dist[u] == INT_MAX) break; 
+            if (u == -1 || u == end) break;
             visited[u] = true;
 
-            EdgeNode* curr = cities[u].edges.head;
-            while (curr) {
+            for (EdgeNode* curr = cities[u].edges.head; curr; curr = curr->next) {
                 int v = curr->data.destCityID;
-                bool isRestrictedEdge = (u == avoidEdgeU && v == avoidEdgeV) || (u == avoidEdgeV && v == avoidEdgeU);
-                
-                if (!isRestrictedEdge) {
-                    int weight = curr->data.weight;
-                    if (!visited[v] && dist[u] + weight < dist[v]) {
-                        dist[v] = dist[u] + weight;
-                        parent[v] = u;
-                    }
+                if (visited[v]) continue;
+                if (avoidBlocked && snap->status[curr->data.roadId] == 3) continue;
+                double at = arrival[u] + edgeTravelSec(snap.get(), curr->data, departSec, arrival[u]);
+                if (arrival[v] < 0 || at < arrival[v]) {
+                    arrival[v] = at;
+                    dist[v] = dist[u] + snap->weight[curr->data.roadId];
+                    parent[v] = u;
                 }
-                curr = curr->next;
             }
         }
 
         PathInfo result;
-        result.totalDist = dist[end];
-        result.isValid = (dist[end] != INT_MAX);
+        result.isValid = arrival[end] >= 0;
+        result.totalDist = result.isValid ? dist[end] : INT_MAX;
+        result.travelSec = result.isValid ? (int)llround(arrival[end]) : 0;
+        result.settledNodes = 0;
+        result.cityCount = 0;
         result.isBlocked = false;
         result.containsTraffic = false;
-        
-        if (result.isValid) {
-            string pathStr = "";
-            int curr = end;
-            StringStack pathStack;
-            
-            while (curr != -1) {
-                pathStack.push(cities[curr].name);
-                int prev = parent[curr];
-                if (prev != -1) {
-                    EdgeNode* edgeNode = cities[prev].edges.head;
-                    while(edgeNode) {
-                        if (edgeNode->data.destCityID == curr) {
-                            if (edgeNode->data.hasTraffic) result.containsTraffic = true;
-                            if (edgeNode->data.isBlocked) result.isBlocked = true;
-                            break;
-                        }
-                        edgeNode = edgeNode->next;
-                    }
+        if (result.isValid) describePath(snap.get(), parent, end, result);
+        else result.pathDescription = "No Path Available";
+        return result;
+    }
+
+    // Fills an S x T table from one network version. Each source row comes from
+    // the cache or from one one-to-all sweep; a reader pinned on an older version
+    // than the cache holds computes its rows privately rather than evict newer ones.
+    void fillDistanceTable(const int* sources, const int* targets, DistanceTable& out) {
+        SnapshotPin snap(*this);
+        out.version = snap->version;
+        int scratch[MAX_CITIES];
+        lock_guard<mutex> lock(rowCacheMutex);
+        if (rowCache->version < snap->version) {
+            rowCache->version = snap->version;
+            for (int i = 0; i < MAX_CITIES; i++) rowCache->ready[i] = false;
+        }
+        bool cacheable = rowCache->version == snap->version;
+
+        for (int i = 0; i < out.sourceCount; i++) {
+            int s = sources[i];
+            int* row = scratch;
+            if (s < 0 || s >= numCities) {
+                for (int j = 0; j < out.targetCount; j++) out.cells[i * out.targetCount + j] = INT_MAX;
+                continue;
+            }
+            if (cacheable) {
+                row = rowCache->rows[s];
+                if (rowCache->ready[s]) {
+                    rowHits++;
+                } else {
+                    distancesFrom(snap.get(), s, row);
+                    rowCache->ready[s] = true;
+                    rowSweeps++;
                 }
-                curr = prev;
+            } else {
+                distancesFrom(snap.get(), s, row);
+                rowSweeps++;
             }
-
-            while(!pathStack.isEmpty()) {
-                pathStr += pathStack.pop();
-                if (!pathStack.isEmpty()) pathStr += " -> ";
+            for (int j = 0; j < out.targetCount; j++) {
+                int t = targets[j];
+                out.cells[i * out.targetCount + j] = (t >= 0 && t < MAX_CITIES) ? row[t] : INT_MAX;
             }
-            result.pathDescription = pathStr;
-            if (result.totalDist >= 999999) result.isBlocked = true; 
-        } else {
-            result.pathDescription = "No Path Available";
         }
+    }
 
-        return result;
+    void distanceCacheStats(long long& sweeps, long long& hits) {
+        lock_guard<mutex> lock(rowCacheMutex);
+        sweeps = rowSweeps;
+        hits = rowHits;
     }
 
     PathInfo calculateAlternativeRoute(int start, int end) {
-        PathInfo best = calculateShortestPath(start, end);
+        SnapshotPin snap(*this);   // Both routes come from the same network state
+        time_t departAt = ClockService::now();
+        PathInfo best = shortestPathIn(snap.get(), start, end, departAt);
         if (!best.isValid) return best; 
         
         EdgeNode* curr = cities[start].edges.head;
         PathInfo secondBest;
         secondBest.totalDist = INT_MAX;
+        secondBest.travelSec = 0;
+        secondBest.settledNodes = 0;
+        secondBest.cityCount = 0;
         secondBest.isValid = false;
         secondBest.isBlocked = false;
 
         while(curr) {
-            PathInfo candidate = calculateShortestPath(start, end, start, curr->data.destCityID);
+            PathInfo candidate = shortestPathIn(snap.get(), start, end, departAt, start, curr->data.destCityID);
             if (candidate.isValid && candidate.totalDist >= best.totalDist && candidate.totalDist < secondBest.totalDist) {
                  if(candidate.pathDescription != best.pathDescription)
                     secondBest = candidate;
@@ -789,57 +4480,73 @@ public:
         return secondBest;
     }
 
-    bool setRoadStatus(int u, int v, int status) {
-        bool found = false;
-        
-        EdgeNode* e1 = cities[u].edges.head;
-        while(e1) {
-            if (e1->data.destCityID == v) {
-                found = true;
-                if (status == 1) { 
-                    e1->data.isBlocked = false;
-                    e1->data.hasTraffic = false;
-                    e1->data.weight = e1->data.baseDistance;
-                } else if (status == 2) { 
-                    e1->data.isBlocked = false;
-                    e1->data.hasTraffic = true;
-                    e1->data.weight = e1->data.baseDistance * 3; 
-                } else if (status == 3) { 
-                    e1->data.isBlocked = true;
-                    e1->data.hasTraffic = false; 
-                    e1->data.weight = e1->data.baseDistance; 
-                }
-                break;
-            }
-            e1 = e1->next;
-        }
-
-        EdgeNode* e2 = cities[v].edges.head;
-        while(e2) {
-            if (e2->data.destCityID == u) {
-                found = true;
-                if (status == 1) { 
-                    e2->data.isBlocked = false;
-                    e2->data.hasTraffic = false;
-                    e2->data.weight = e2->data.baseDistance;
-                } else if (status == 2) { 
-                    e2->data.isBlocked = false;
-                    e2->data.hasTraffic = true;
-                    e2->data.weight = e2->data.baseDistance * 3; 
-                } else if (status == 3) { 
-                    e2->data.isBlocked = true;
-                    e2->data.hasTraffic = false; 
-                    e2->data.weight = e2->data.baseDistance;
-                }
-                break;
-            }
-            e2 = e2->next;
+    // Applies a whole batch on one copy and publishes it as a single version, so a
+    // feed of thousands of roads costs one snapshot and queries never see it half
+    // applied. Marks each update applied (with its previous state) or records why
+    // it was not in reject. Returns the number applied.
+    int applyRoadUpdates(RoadUpdate* updates, int n) {
+        lock_guard<mutex> lock(writerMutex);
+        RoadSnapshot* next = current.load()->copy(roadCount);
+        int applied = 0;
+        bool splitPossible = false;
+        for (int i = 0; i < n; i++) {
+            RoadUpdate& r = updates[i];
+            int id = findRoad(r.u, r.v);
+            if (id < 0) r.reject = ROAD_NO_SUCH_ROAD;
+            else if (r.status < 1 || r.status > 3) r.reject = ROAD_BAD_STATUS;
+            else if (r.factor < 1000 || r.factor > TRAFFIC_FACTOR_MAX) r.reject = ROAD_BAD_FACTOR;
+            else r.reject = ROAD_APPLIED;
+            r.applied = r.reject == ROAD_APPLIED;
+            if (!r.applied) continue;
+            r.beforeStatus = next->status[id];
+            r.beforeFactor = next->factor[id];
+            next->status[id] = (unsigned char)r.status;
+            next->factor[id] = (unsigned short)r.factor;
+            next->weight[id] = weightFor(baseDistanceOf(r.u, id), r.status, r.factor);
+            if (r.status == 3 && r.beforeStatus != 3) splitPossible = true;
+            else if (r.status != 3) unite(next->openComponent, r.u, r.v);
+            applied++;
         }
-        return found;
+        if (applied == 0) {
+            delete next;
+            return 0;
+        }
+        if (splitPossible) rebuildOpenComponents(next);
+        else flatten(next->openComponent);
+        publish(next);
+        return applied;
+    }
+
+    // Publishes a new snapshot; queries already running keep the one they pinned
+    bool setRoadStatus(int u, int v, int status, int factor = 0) {
+        RoadUpdate r(u, v, status);
+        if (factor > 0) r.factor = factor;
+        return applyRoadUpdates(&r, 1) == 1;
     }
     
+    // 1 normal, 2 traffic, 3 blocked, 0 if there is no direct road
+    int getRoadStatus(int u, int v) {
+        int id = findRoad(u, v);
+        if (id < 0) return 0;
+        SnapshotPin snap(*this);
+        return snap->status[id];
+    }
+
+    // Writes every non-normal road once (u < v) for a snapshot
+    void exportRoadStatuses(RecordWriter& out) {
+        SnapshotPin snap(*this);
+        for (int u = 0; u < numCities; u++) {
+            for (EdgeNode* e = cities[u].edges.head; e; e = e->next) {
+                if (e->data.destCityID <= u) continue;
+                int status = snap->status[e->data.roadId];
+                if (status != 1) out.putRoad(u, e->data.destCityID, status, snap->factor[e->data.roadId]);
+            }
+        }
+    }
+
     void printGraphTable() {
-        UIHelper::printHeader("ROAD NETWORK STATUS REPORT");
+        SnapshotPin snap(*this);
+        UIHelper::printHeader("ROAD NETWORK STATUS REPORT (VERSION " + to_string(snap->version) + ")");
         cout << BLUE << " | " << setw(15) << "CITY A" 
              << " | " << setw(15) << "CITY B" 
              << " | " << setw(8) << "DIST(km)"
@@ -854,8 +4561,14 @@ public:
                 if(curr->data.destCityID > i) {
                     string stat = "Normal";
                     string color = GREEN;
-                    if(curr->data.isBlocked) { stat = "BLOCKED"; color = RED; }
-                    else if(curr->data.hasTraffic) { stat = "HEAVY TRAFFIC"; color = YELLOW; }
+                    int status = snap->status[curr->data.roadId];
+                    if(status == 3) { stat = "BLOCKED"; color = RED; }
+                    else if(status == 2) {
+                        int factor = snap->factor[curr->data.roadId];
+                        stat = "HEAVY TRAFFIC";
+                        if (factor != TRAFFIC_FACTOR_DEFAULT) stat = "TRAFFIC x" + to_string(factor / 1000) + "." + to_string(factor / 10 % 100 / 10) + to_string(factor / 10 % 10);
+                        color = YELLOW;
+                    }
 
                     cout << " | " << setw(15) << cities[i].name 
                          << " | " << setw(15) << cities[curr->data.destCityID].name
@@ -867,6 +4580,26 @@ public:
             }
         }
         UIHelper::printLine();
+
+        // One line per open partition once blocks have split the network
+        int roots[MAX_CITIES];
+        int partitions = 0;
+        for (int i = 0; i < numCities; i++) {
+            if (cities[i].name != "" && snap->openComponent[i] == i) roots[partitions++] = i;
+        }
+        if (partitions > 1) {
+            cout << RED << BOLD << "\n >> NETWORK SPLIT BY BLOCKS: " << partitions << " partitions (no open route between them)" << RESET << endl;
+            for (int k = 0; k < partitions; k++) {
+                cout << "    [" << (char)('A' + k % 26) << "] ";
+                bool first = true;
+                for (int i = 0; i < numCities; i++) {
+                    if (cities[i].name == "" || snap->openComponent[i] != roots[k]) continue;
+                    cout << (first ? "" : ", ") << cities[i].name;
+                    first = false;
+                }
+                cout << endl;
+            }
+        }
         
         cout << BOLD << "\n >> CITY ID REFERENCE (Use these IDs for input):" << RESET << endl;
         for(int i=0; i<numCities; i+=2) {
@@ -890,46 +4623,168 @@ private:
     TrackingHashTable trackingSystem;
     LogisticsGraph routingEngine;
     ParcelPriorityQueue warehouseQueue; 
-    ArchiveBST archive;                 
+    ParcelArchive archive;              
     
     ParcelQueue pickupQueue;   
     ParcelList transitList;    
     
-    Rider* fleet[5];
+    Rider* fleet[MAX_FLEET];
     int fleetSize;
 
-    UndoStack undoStack;
+    CommandLog commands;        // Undoable transactions (bounded ring)
+    ParcelIdRegistry parcelIds; // Booking IDs in use (hot and cold), claimable without the engine lock
     ParcelList masterList;
+    ParcelColumnStore columns;  // Analytics mirror of masterList
+    AnalyticsCounters stats;    // O(1) dashboard totals
+    RollupEngine rollups;       // Per city-pair time buckets
+    ParcelIndexes indexes;      // Status / city / rider drill-down lists
+    WriteAheadLog wal;          // Durable log of every state transition
+    ColdArchive cold;           // Finished parcels paged out of RAM
+
+    // Persistence bookkeeping (shown in the Admin Panel)
+    long long recoveredParcels;
+    long long recoveredRecords;
+    long long recoveryMs;
+    long long checkpointCount;
+    long long lastCheckpointParcels;
+    time_t lastCheckpointAt;
+    long long coldFlushCount;
+    time_t lastColdFlushAt;
+    long long coldWatermark;    // Cold rows the log says were durable
+    long long unrestoredNames;  // Name / route records that found their table full
+    long long replayedLogGeneration; // Begin generation of the log recovery applied (-1 = none)
+    bool snapshotInFlight;      // A checkpoint is writing with engineMutex released
+    bool coldFlushInFlight;     // A cold-tier flush is syncing with engineMutex released
+
+    // Background auto-dispatch scheduler. Every menu action and every scheduler
+    // tick runs under engineMutex so the two threads never touch queues together.
+    mutex engineMutex;
+    thread schedulerThread;
+    condition_variable schedulerWake;
+    atomic<bool> schedulerRunning;
+    int fillThreshold;        // Parcels per city warehouse
+    int batchWindowSec;       // Seconds since the current batch opened
+    time_t batchOpenedAt;     // 0 while the warehouse is empty
+    int autoWaveCount;
+    int autoDispatchedCount;
+    string pendingAlerts;     // Simulation alerts raised by the scheduler, printed by the menus
+    int pendingAlertCount;
 
 public:
-    SwiftExEngine() {
+    SwiftExEngine()
+        : recoveredParcels(0), recoveredRecords(0), recoveryMs(0), checkpointCount(0),
+          lastCheckpointParcels(0), lastCheckpointAt(0), coldFlushCount(0), lastColdFlushAt(0),
+          coldWatermark(0), unrestoredNames(0), replayedLogGeneration(-1), snapshotInFlight(false), coldFlushInFlight(false), schedulerRunning(false), fillThreshold(AUTO_DISPATCH_FILL_THRESHOLD),
+          batchWindowSec(AUTO_DISPATCH_WINDOW_SEC), batchOpenedAt(0),
+          autoWaveCount(0), autoDispatchedCount(0), pendingAlertCount(0) {
         initMap();
         initFleet();
+        if (!cold.open()) cout << RED << " [!] Cold tier files could not be opened. Finished parcels stay in memory." << RESET << endl;
+        lastColdFlushAt = ClockService::now();
+        recoverState();
+        startScheduler();
+    }
+
+    ~SwiftExEngine() {
+        stopScheduler();
+        wal.commit();
+    }
+
+    void startScheduler() {
+        if (schedulerRunning) return;
+        schedulerRunning = true;
+        schedulerThread = thread(&SwiftExEngine::schedulerLoop, this);
+    }
+
+    void stopScheduler() {
+        if (!schedulerRunning) return;
+        {
+            lock_guard<mutex> lock(engineMutex);
+            schedulerRunning = false;
+        }
+        schedulerWake.notify_all();
+        if (schedulerThread.joinable()) schedulerThread.join();
+    }
+
+    void schedulerLoop() {
+        unique_lock<mutex> lock(engineMutex);
+        while (schedulerRunning) {
+            schedulerWake.wait_for(lock, chrono::milliseconds(SCHEDULER_POLL_MS));
+            if (!schedulerRunning) break;
+            updateSimulation();
+            time_t now = ClockService::now();
+            schedulerTick(now);
+            rollups.compact(now);
+            wal.commit();
+            if (archive.size() >= COLD_FLUSH_MIN_PARCELS ||
+                (!archive.isEmpty() && difftime(now, lastColdFlushAt) >= COLD_FLUSH_INTERVAL_SEC)) {
+                flushColdTier(lock);
+            }
+            if (wal.size() >= SNAPSHOT_WAL_BYTES) checkpoint(lock);
+        }
+    }
+
+    // Runs a wave when any city warehouse reaches the fill threshold, or when the
+    // oldest batch has waited for the full window, whichever comes first.
+    // Caller must hold engineMutex.
+    void schedulerTick(time_t now) {
+        if (warehouseQueue.isEmpty()) {
+            batchOpenedAt = 0;
+            return;
+        }
+        if (batchOpenedAt == 0) batchOpenedAt = now;
+
+        int cityLoad[MAX_CITIES] = {0};
+        bool thresholdHit = false;
+        for (int i = 0; i < warehouseQueue.size(); i++) {
+            int cityID = warehouseQueue.getAtIndex(i)->sourceCityID;
+            if (cityID >= 0 && ++cityLoad[cityID] >= fillThreshold) {
+                thresholdHit = true;
+                break;
+            }
+        }
+        bool windowExpired = difftime(now, batchOpenedAt) >= batchWindowSec;
+        if (!thresholdHit && !windowExpired) return;
+
+        int sent = runAutoDispatchWave(INT_MAX, thresholdHit ? EV_AUTO_DISPATCH_FULL : EV_AUTO_DISPATCH_WINDOW);
+        if (sent > 0) autoWaveCount++;
+        autoDispatchedCount += sent;
+        // Whatever could not be placed starts a fresh window instead of retrying every poll
+        batchOpenedAt = warehouseQueue.isEmpty() ? 0 : now;
     }
 
     void initMap() {
         // Start from ID 1
-        routingEngine.addCity(1, "Lahore");
-        routingEngine.addCity(2, "Islamabad");
-        routingEngine.addCity(3, "Karachi");
-        routingEngine.addCity(4, "Rawalpindi");
-        routingEngine.addCity(5, "Faisalabad");
-        routingEngine.addCity(6, "Multan");
-        routingEngine.addCity(7, "Peshawar");
-        routingEngine.addCity(8, "Quetta");
-        routingEngine.addCity(9, "Sialkot");
-        routingEngine.addCity(10, "Gujranwala");
-
-        routingEngine.addRoad(1, 2, 375); // LHR-ISL
-        routingEngine.addRoad(2, 4, 20);  // ISL-RWP
-        routingEngine.addRoad(1, 10, 70); // LHR-GUJ
-        routingEngine.addRoad(10, 9, 55); // GUJ-SKT
-        routingEngine.addRoad(1, 5, 180); // LHR-FSD
-        routingEngine.addRoad(5, 6, 250); // FSD-MUX
-        routingEngine.addRoad(6, 3, 900); // MUX-KHI
-        routingEngine.addRoad(6, 8, 650); // MUX-QTA
-        routingEngine.addRoad(3, 8, 690); // KHI-QTA
-        routingEngine.addRoad(2, 7, 190); // ISL-PEW
+        routingEngine.addCity(1, "Lahore", 31.5204, 74.3587);
+        routingEngine.addCity(2, "Islamabad", 33.6844, 73.0479);
+        routingEngine.addCity(3, "Karachi", 24.8607, 67.0011);
+        routingEngine.addCity(4, "Rawalpindi", 33.5651, 73.0169);
+        routingEngine.addCity(5, "Faisalabad", 31.4504, 73.1350);
+        routingEngine.addCity(6, "Multan", 30.1575, 71.5249);
+        routingEngine.addCity(7, "Peshawar", 34.0151, 71.5249);
+        routingEngine.addCity(8, "Quetta", 30.1798, 66.9750);
+        routingEngine.addCity(9, "Sialkot", 32.4945, 74.5229);
+        routingEngine.addCity(10, "Gujranwala", 32.1877, 74.1945);
+
+        // Rush-hour travel profiles (minute of day, factor x1000)
+        const ProfilePoint cityRush[] = {{0, 1000}, {420, 1000}, {510, 1800}, {630, 1100}, {1020, 1100}, {1110, 2000}, {1230, 1000}};
+        const ProfilePoint motorway[] = {{0, 1000}, {450, 1000}, {540, 1300}, {660, 1000}, {1050, 1000}, {1140, 1400}, {1260, 1000}};
+        const ProfilePoint freight[] = {{0, 1200}, {360, 1000}, {1320, 1000}}; // Night truck convoys on the N-25
+        int city = routingEngine.addTravelProfile(cityRush, 7);
+        int mway = routingEngine.addTravelProfile(motorway, 7);
+        int night = routingEngine.addTravelProfile(freight, 3);
+
+        routingEngine.addRoad(1, 2, 375, mway);  // LHR-ISL
+        routingEngine.addRoad(2, 4, 20, city);   // ISL-RWP
+        routingEngine.addRoad(1, 10, 70, city);  // LHR-GUJ
+        routingEngine.addRoad(10, 9, 55, city);  // GUJ-SKT
+        routingEngine.addRoad(1, 5, 180, mway);  // LHR-FSD
+        routingEngine.addRoad(5, 6, 250, mway);  // FSD-MUX
+        routingEngine.addRoad(6, 3, 900, mway);  // MUX-KHI
+        routingEngine.addRoad(6, 8, 650);        // MUX-QTA
+        routingEngine.addRoad(3, 8, 690, night); // KHI-QTA
+        routingEngine.addRoad(2, 7, 190, mway);  // ISL-PEW
+        routingEngine.prepareLandmarks();
     }
 
     void initFleet() {
@@ -942,6 +4797,339 @@ public:
         fleet[3] = new Rider(104, "Dawood (Van)", "Van", 200.0);
         fleet[4] = new Rider(103, "Chacha (Truck)", "Truck", 1000.0);
         fleetSize = 5;
+        for (int i = 0; i < fleetSize; i++) fleet[i]->fleetIndex = i;
+    }
+
+    // Loads the latest snapshot, replays the log written after it, rebuilds every
+    // queue, index and counter in one pass, then checkpoints so the next start is
+    // a plain snapshot load. Runs from the constructor, before the scheduler starts.
+    void recoverState() {
+        auto started = chrono::steady_clock::now();
+        restoreColdTotals();
+        long long generation = 0, cutOffset = -1;
+        RecordReader reader;
+        if (reader.open(SNAPSHOT_PATH)) {
+            recoveredRecords += replayRecords(reader, generation, cutOffset, false);
+        }
+        long long logEnd = 0;
+        if (reader.open(WAL_PATH)) {
+            recoveredRecords += replayRecords(reader, generation, cutOffset, true);
+            logEnd = reader.validBytes();
+        }
+        reader.close();
+        if (unrestoredNames > 0) {
+            cout << RED << " [!] " << unrestoredNames << " stored names/routes did not fit the session tables."
+                 << " Parcels referring to them show none." << RESET << endl;
+        }
+        if (cold.size() < coldWatermark) {
+            cout << RED << " [!] Cold tier holds " << cold.size() << " rows but the log recorded " << coldWatermark
+                 << ". Flushed parcels whose images have left the log are missing." << RESET << endl;
+        }
+
+        for (ParcelNode* n = masterList.head; n; n = n->next) {
+            attachRecovered(n->data);
+            parcelIds.claim(n->data->id);
+            recoveredParcels++;
+        }
+        recoveryMs = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - started).count();
+
+        wal.setGeneration(generation);
+        unique_lock<mutex> lock(engineMutex);
+        if (checkpoint(lock)) return;
+        // The log just replayed holds everything since the last good snapshot: keep
+        // appending to it rather than truncating (an ignored log has nothing to keep)
+        if (replayedLogGeneration >= 0) wal.resume(replayedLogGeneration, logEnd);
+        else wal.start(generation);
+    }
+
+    // Applies records in file order. For a log, generation holds the one the snapshot
+    // handed over to; an older log predates that snapshot and is ignored, except
+    // for the part written after the snapshot's cut when the hand-over never happened.
+    long long replayRecords(RecordReader& reader, long long& generation, long long& cutOffset, bool isLog) {
+        long long applied = 0;
+        unsigned char type;
+        const char* data;
+        unsigned int length;
+        while (reader.next(type, data, length)) {
+            switch (type) {
+                case REC_LOG_BEGIN: {
+                    long long g = 0;
+                    if (length >= sizeof(g)) memcpy(&g, data, sizeof(g));
+                    if (isLog && g < generation) {
+                        if (g == generation - 1 && cutOffset > 0 && reader.seek(cutOffset)) {
+                            replayedLogGeneration = g;
+                            break;
+                        }
+                        return applied;
+                    }
+                    generation = g;
+                    if (isLog) replayedLogGeneration = g;
+                    break;
+                }
+                case REC_SNAPSHOT_END: {
+                    long long f[3] = {0, 0, -1};   // Older snapshots carry no cut offset
+                    if (length < sizeof(generation)) break;
+                    memcpy(f, data, min((size_t)length, sizeof(f)));
+                    generation = f[0];
+                    cutOffset = f[2];
+                    break;
+                }
+                case REC_NAME:
+                    if (!reader.readName(data, length)) unrestoredNames++;
+                    break;
+                case REC_ROUTE:
+                    if (!reader.readRoute(data, length)) unrestoredNames++;
+                    break;
+                case REC_PARCEL: {
+                    if (length < sizeof(ParcelImage)) break;
+                    int id;
+                    memcpy(&id, data, sizeof(id));
+                    // Already moved to the cold tier before the last snapshot was replaced
+                    if (cold.contains(id)) break;
+                    // Decoded on its own first: a bad record must not leave a shell parcel behind
+                    Parcel* p = new Parcel(id);
+                    int carrier = -1;
+                    if (!reader.readParcel(data, length, p, carrier)) {
+                        delete p;
+                        break;
+                    }
+                    p->assignedRider = (carrier >= 0 && carrier < fleetSize) ? fleet[carrier] : nullptr;
+                    // A later image replaces the earlier one in place, keeping its master-list position
+                    Parcel* older = trackingSystem.search(id);
+                    if (older) {
+                        p->masterNode = older->masterNode;
+                        p->masterNode->data = p;
+                        trackingSystem.remove(id);
+                        delete older;
+                    } else {
+                        p->masterNode = masterList.pushBack(p);
+                    }
+                    trackingSystem.insert(p);
+                    break;
+                }
+                case REC_ROAD: {
+                    int f[4] = {0, 0, 0, 0};   // Older logs carry no factor field
+                    if (length < 3 * sizeof(int)) break;
+                    memcpy(f, data, min((size_t)length, sizeof(f)));
+                    if (f[0] >= 0 && f[0] < MAX_CITIES && f[1] >= 0 && f[1] < MAX_CITIES) {
+                        routingEngine.setRoadStatus(f[0], f[1], f[2], f[3]);
+                    }
+                    break;
+                }
+                case REC_DROP: {
+                    int id;
+                    if (length < sizeof(id)) break;
+                    memcpy(&id, data, sizeof(id));
+                    Parcel* p = trackingSystem.search(id);
+                    if (p) {
+                        masterList.removeNode(p->masterNode);
+                        trackingSystem.remove(id);
+                        delete p;
+                    }
+                    break;
+                }
+                case REC_COLD_MARK: {
+                    long long f[2];
+                    if (length < sizeof(f)) break;
+                    memcpy(f, data, sizeof(f));
+                    coldWatermark = max(coldWatermark, f[0]);
+                    break;
+                }
+                case REC_SCHEDULER: {
+                    int f[2];
+                    if (length < sizeof(f)) break;
+                    memcpy(f, data, sizeof(f));
+                    fillThreshold = f[0];
+                    batchWindowSec = f[1];
+                    break;
+                }
+            }
+            applied++;
+        }
+        return applied;
+    }
+
+    // Puts a recovered parcel back into every structure its final state implies
+    void attachRecovered(Parcel* p) {
+        int riderSlot = p->indexedRider;
+        p->indexedRider = -1;
+        if (riderSlot >= fleetSize) riderSlot = -1;
+
+        columns.add(p);
+        stats.onRestore(p, riderSlot >= 0 ? fleet[riderSlot] : nullptr);
+        indexes.add(p);
+        indexes.setRider(p, riderSlot);
+        if (p->sourceCityID >= 0 && p->destCityID >= 0) {
+            time_t now = ClockService::now();
+            rollups.restoreBooking(p->sourceCityID, p->destCityID, fromParcelTime(p->creationTime), now);
+            if (p->status == ST_DELIVERED) rollups.restoreDelivery(p, fromParcelTime(p->completionTime), now);
+        }
+
+        switch (p->status) {
+            case ST_PICKUP:
+                p->pickupNode = pickupQueue.enqueue(p);
+                break;
+            case ST_WAREHOUSE:
+                warehouseQueue.insert(p);
+                break;
+            case ST_IN_TRANSIT:
+            case ST_RETURNING:
+                p->transitNode = transitList.pushBack(p);
+                if (p->assignedRider) p->assignedRider->assignParcel(p->weight());
+                break;
+            case ST_DELIVERED:
+            case ST_RETURNED:
+                archive.insert(p);
+                break;
+        }
+    }
+
+    // Cold rows never come back into RAM, but the running totals and rollups still
+    // count them: one pass over the mapped columns rebuilds their share.
+    void restoreColdTotals() {
+        Parcel row(0);
+        time_t now = ClockService::now();
+        for (long long r = 0; r < cold.size(); r++) {
+            cold.readSummary(r, row);
+            parcelIds.claim(row.id);
+            int riderSlot = row.indexedRider;
+            stats.onRestore(&row, (riderSlot >= 0 && riderSlot < fleetSize) ? fleet[riderSlot] : nullptr);
+            // Rows are in delivery order, so booking times jump around: order-free rebuild
+            if (row.sourceCityID >= 0 && row.destCityID >= 0) {
+                rollups.restoreBooking(row.sourceCityID, row.destCityID, fromParcelTime(row.creationTime), now);
+                if (row.status == ST_DELIVERED) rollups.restoreDelivery(&row, fromParcelTime(row.completionTime), now);
+            }
+        }
+    }
+
+    // Recounts every rider's deliveries from the parcels (hot and cold), the same
+    // way recovery credits them. Caller holds engineMutex.
+    void rebuildRiderTotals() {
+        for (int i = 0; i < fleetSize; i++) {
+            fleet[i]->deliveredCount = 0;
+            fleet[i]->deliveredKg = 0;
+        }
+        for (ParcelNode* n = masterList.head; n; n = n->next) {
+            Parcel* p = n->data;
+            if (p->status != ST_DELIVERED || p->indexedRider < 0 || p->indexedRider >= fleetSize) continue;
+            fleet[p->indexedRider]->deliveredCount++;
+            fleet[p->indexedRider]->deliveredKg += p->weight();
+        }
+        Parcel row(0);
+        for (long long r = 0; r < cold.size(); r++) {
+            cold.readSummary(r, row);
+            if (row.status != ST_DELIVERED || row.indexedRider < 0 || row.indexedRider >= fleetSize) continue;
+            fleet[row.indexedRider]->deliveredCount++;
+            fleet[row.indexedRider]->deliveredKg += row.weight();
+        }
+    }
+
+    // Moves every archived parcel to the cold tier, oldest delivery first, then
+    // frees it. Only a small watermark record goes to the log: replay already skips
+    // images of cold parcels, and the next size-triggered snapshot stops carrying
+    // them, so restart and memory both scale with the live parcels. The rows are
+    // copied under engineMutex and synced with it released, like a checkpoint;
+    // the caller holds it through `lock`, and holds it again on return.
+    bool flushColdTier(unique_lock<mutex>& lock) {
+        lastColdFlushAt = ClockService::now();
+        if (coldFlushInFlight || archive.isEmpty() || !cold.isOpen()) return false;
+        int n = archive.size();
+        Parcel** batch = new Parcel*[n];
+        int count = 0;
+        for (ArchiveCursor c = archive.seekTime(0); c.isValid() && count < n; c.advance()) batch[count++] = c.value();
+
+        // Parcels are only freed once their rows are durable
+        if (!cold.stageAppend(batch, count)) {
+            delete[] batch;
+            return false;
+        }
+        coldFlushInFlight = true;
+        lock.unlock();
+        cold.syncStaged();
+        lock.lock();
+        coldFlushInFlight = false;
+        cold.publishStaged();
+
+        coldWatermark = cold.size();
+        wal.logColdMark(coldWatermark, cold.maxParcelId());
+        wal.commit();
+        if (archive.size() == count) {
+            archive.clear();
+        } else {
+            // Deliveries archived while the lock was released wait for the next flush
+            int total = archive.size(), kept = 0;
+            Parcel** keep = new Parcel*[total];
+            for (ArchiveCursor c = archive.seekTime(0); c.isValid(); c.advance()) {
+                if (!cold.contains(c.value()->id)) keep[kept++] = c.value();
+            }
+            archive.clear();
+            for (int i = 0; i < kept; i++) archive.insert(keep[i]);
+            delete[] keep;
+        }
+        for (int i = 0; i < count; i++) evictParcel(batch[i]);
+        delete[] batch;
+        coldFlushCount++;
+        return true;
+    }
+
+    // Unlinks a finished parcel from every in-memory structure and frees it
+    void evictParcel(Parcel* p) {
+        masterList.removeNode(p->masterNode);
+        trackingSystem.remove(p->id);
+        indexes.remove(p);
+        columns.remove(p);
+        delete p;
+    }
+
+    // Writes a full snapshot beside the current one, swaps it in with rename(), and
+    // only then starts a new log generation. Under the lock the parcel images are
+    // only copied into the writer's memory buffer and the log is cut; the file
+    // write and fsync run with engineMutex released, while new transitions keep
+    // going to the old log after the cut. The caller holds engineMutex through
+    // `lock`, and holds it again on return.
+    bool checkpoint(unique_lock<mutex>& lock) {
+        if (snapshotInFlight) return false;
+        long long generation = wal.currentGeneration();
+        string tmpPath = string(SNAPSHOT_PATH) + ".tmp";
+        RecordWriter snap;
+        if (!snap.open(tmpPath.c_str(), "wb")) return false;
+
+        snap.putScheduler(fillThreshold, batchWindowSec);
+        routingEngine.exportRoadStatuses(snap);
+        long long count = 0;
+        for (ParcelNode* n = masterList.head; n; n = n->next) {
+            snap.putParcel(n->data);
+            count++;
+        }
+        long long cutOffset = wal.cut();
+        snap.putSnapshotEnd(generation + 1, count, cutOffset);
+
+        snapshotInFlight = true;
+        lock.unlock();
+        bool ok = snap.flush(true);
+        snap.close();
+        ok = ok && rename(tmpPath.c_str(), SNAPSHOT_PATH) == 0;
+        if (!ok) remove(tmpPath.c_str());
+        lock.lock();
+        snapshotInFlight = false;
+        if (!ok) return false;
+
+        // A failed hand-over keeps the old log; replay then resumes it at the cut
+        wal.handOver(generation + 1, cutOffset);
+        checkpointCount++;
+        lastCheckpointParcels = count;
+        lastCheckpointAt = ClockService::now();
+        return true;
+    }
+
+    // Clean exit: stop background work and leave a fresh snapshot behind
+    void shutdown() {
+        stopScheduler();
+        {
+            unique_lock<mutex> lock(engineMutex);
+            checkpoint(lock);
+        }
+        ClockService::stopTicker();
     }
 
     void registerParcel() {
@@ -952,7 +5140,7 @@ public:
         while(true) {
             id = UIHelper::getIntInput(" >> Enter Parcel ID (Positive, 0 to Cancel): ", 0, 99999);
             if (id == 0) return;
-            if (trackingSystem.search(id) == nullptr) break;
+            if (!parcelIds.isClaimed(id)) break;
             cout << RED << " [!] Error: Parcel ID " << id << " already exists. Try another." << RESET << endl;
         }
 
@@ -989,7 +5177,20 @@ public:
         int p = UIHelper::getIntInput(" >> Select Priority Level: ", 1, 3);
 
         Parcel* newP = new Parcel(id, src, dest, w, p);
+        newP->sourceCityID = srcID;
+        newP->destCityID = destID;
         
+        // Connectivity index: rejected before any route search
+        if (!routingEngine.connected(srcID, destID)) {
+            cout << RED << " [!] CRITICAL: No path exists between these cities (Network Disconnected)." << RESET << endl;
+            delete newP;
+            UIHelper::pressEnterToContinue();
+            return;
+        }
+        if (!routingEngine.openlyConnected(srcID, destID)) {
+            cout << RED << " [!] Every route between these cities crosses a blocked road." << RESET << endl;
+        }
+
         cout << "\n" << BOLD << " >> CALCULATING ROUTES..." << RESET << endl;
         PathInfo best = routingEngine.calculateShortestPath(srcID, destID);
         PathInfo alt = routingEngine.calculateAlternativeRoute(srcID, destID);
@@ -1029,70 +5230,586 @@ public:
         
         if (selected.isBlocked) {
              cout << RED << " [WARNING] You have selected a BLOCKED route. Delivery may fail." << RESET << endl;
-             newP->willFailOnPath = true;
         }
 
-        newP->assignedRoute = selected.pathDescription;
-        newP->totalDistanceKm = selected.totalDist;
-        newP->estimatedDurationSec = selected.totalDist / SIM_SPEED_KM_PER_SEC;
-        
-        // --- COST CALCULATION BREAKDOWN ---
-        double baseFee = 100.0;
-        double weightFee = newP->weight * 15.0;
-        double priorityFee = (newP->priorityLevel == 1) ? 500.0 : ((newP->priorityLevel == 2) ? 200.0 : 0.0);
-        double distanceFee = newP->totalDistanceKm * 5.0; // UPDATED DISTANCE RATE
-        
-        newP->shippingCost = baseFee + weightFee + priorityFee + distanceFee;
+        ParcelQuote quote;
+        string priceError;
+        if (!priceParcel(newP, selected, quote, priceError)) {
+            cout << RED << " [!] Error: Cannot book this parcel: " << priceError << "." << RESET << endl;
+            delete newP;
+            UIHelper::pressEnterToContinue();
+            return;
+        }
         
         cout << endl;
         UIHelper::printSubHeader("COST BREAKDOWN");
-        cout << " + Base Fee:       " << setw(8) << fixed << setprecision(2) << baseFee << " PKR" << endl;
-        cout << " + Weight Charge:  " << setw(8) << weightFee << " PKR (" << w << " kg * 15)" << endl;
-        cout << " + Priority Fee:   " << setw(8) << priorityFee << " PKR (" << newP->getPriorityStr() << ")" << endl;
-        cout << " + Distance Fee:   " << setw(8) << distanceFee << " PKR (" << newP->totalDistanceKm << " km * 5.0)" << endl;
+        cout << " + Base Fee:       " << setw(8) << fixed << setprecision(2) << quote.baseFee << " PKR" << endl;
+        cout << " + Weight Charge:  " << setw(8) << quote.weightFee << " PKR (" << w << " kg * 15)" << endl;
+        cout << " + Priority Fee:   " << setw(8) << quote.priorityFee << " PKR (" << newP->getPriorityStr() << ")" << endl;
+        cout << " + Distance Fee:   " << setw(8) << quote.distanceFee << " PKR (" << newP->totalDistanceKm << " km * 5.0)" << endl;
         UIHelper::printLine();
-        cout << BOLD << " = TOTAL COST:     " << GREEN << setw(8) << newP->shippingCost << " PKR" << RESET << endl;
+        cout << BOLD << " = TOTAL COST:     " << GREEN << setw(8) << newP->shippingCost() << " PKR" << RESET << endl;
         UIHelper::printLine();
-        
-        newP->addToHistory("Route Assigned: " + selected.pathDescription);
 
-        masterList.pushBack(newP);
-        trackingSystem.insert(newP);
-        pickupQueue.enqueue(newP); 
+        // A server counter may have taken the ID while this form was being filled in
+        if (!parcelIds.claim(id)) {
+            cout << RED << " [!] Error: Parcel ID " << id << " was just registered at another counter." << RESET << endl;
+            delete newP;
+            UIHelper::pressEnterToContinue();
+            return;
+        }
+
+        // Once admitted the scheduler may move the parcel on, so read what we print first
+        int etaSec = newP->estimatedDurationSec;
+        {
+            lock_guard<mutex> lock(engineMutex);
+            commands.begin(TXN_REGISTER, newP->id);
+            admitParcel(newP);
+            commands.end();
+            wal.commit();
+        }
+
+        cout << GREEN << " >> Success: Parcel Registered and placed in Pickup Queue." << RESET << endl;
+        cout << " >> Estimated Duration: " << etaSec << " seconds" << endl;
+        UIHelper::pressEnterToContinue();
+    }
+
+    // Route, distance, duration and price for a new booking. False with a reason
+    // when the route does not fit the parcel's compact fields.
+    bool priceParcel(Parcel* p, const PathInfo& route, ParcelQuote& q, string& error) {
+        if (route.totalDist > USHRT_MAX) { error = "route is longer than " + to_string(USHRT_MAX) + " km"; return false; }
+        if (route.travelSec > USHRT_MAX) { error = "route takes longer than " + to_string(USHRT_MAX) + " seconds"; return false; }
+        if (!RouteTable::intern(route.cityPath, route.cityCount, p->routeId)) { error = "route table is full"; return false; }
+        p->totalDistanceKm = (unsigned short)route.totalDist;
+        p->estimatedDurationSec = (unsigned short)route.travelSec; // Includes rush hours at booking time
+        if (route.isBlocked) p->willFailOnPath = true;
+
+        // --- COST CALCULATION BREAKDOWN ---
+        q.baseFee = 100.0;
+        q.weightFee = p->weight() * 15.0;
+        q.priorityFee = (p->priorityLevel == 1) ? 500.0 : ((p->priorityLevel == 2) ? 200.0 : 0.0);
+        q.distanceFee = p->totalDistanceKm * 5.0; // UPDATED DISTANCE RATE
+        p->costPaisa = (unsigned int)llround((q.baseFee + q.weightFee + q.priorityFee + q.distanceFee) * 100.0);
+        p->addToHistory(EV_ROUTE_ASSIGNED, p->routeId);
+        return true;
+    }
+
+    // Links a priced parcel (ID already claimed) into every structure and queues it
+    // for pickup. Caller holds engineMutex, has a command transaction open and commits the WAL.
+    void admitParcel(Parcel* p) {
+        p->masterNode = masterList.pushBack(p);
+        columns.add(p);
+        stats.onRegister(p);
+        indexes.add(p);
+        rollups.recordBooking(p->sourceCityID, p->destCityID, fromParcelTime(p->creationTime));
+        trackingSystem.insert(p);
+        p->pickupNode = pickupQueue.enqueue(p);
+        commands.record(CMD_REGISTER, p->id);
+        wal.markDirty(p);
+    }
+
+    // --- Server entry points (each takes the locks it needs) ---
+
+    // Builds and prices a booking without engineMutex; the route comes from a
+    // pinned road snapshot. Returns nullptr with a reason on rejection.
+    Parcel* quoteRegistration(int id, int srcID, int destID, double kg, int priority, string& error) {
+        string src = routingEngine.getCityName(srcID);
+        string dest = routingEngine.getCityName(destID);
+        if (src == "Unknown" || dest == "Unknown") { error = "unknown city"; return nullptr; }
+        if (srcID == destID) { error = "source and destination are the same"; return nullptr; }
+        if (kg <= 0.0 || kg > 1000.0) { error = "weight must be 0-1000 kg"; return nullptr; }
+        if (priority < 1 || priority > 3) { error = "priority must be 1-3"; return nullptr; }
+
+        PathInfo best = routingEngine.calculateShortestPath(srcID, destID);
+        if (!best.isValid) { error = "no path between these cities"; return nullptr; }
+
+        Parcel* p = new Parcel(id, src, dest, kg, priority);
+        p->sourceCityID = srcID;
+        p->destCityID = destID;
+        ParcelQuote quote;
+        if (!priceParcel(p, best, quote, error)) {
+            delete p;
+            return nullptr;
+        }
+        return p;
+    }
+
+    // Commits a shard's batch: one engine lock, one undo transaction, one fsync
+    void admitBatch(Parcel** batch, int n) {
+        if (n == 0) return;
+        lock_guard<mutex> lock(engineMutex);
+        commands.begin(TXN_COUNTER_BATCH, n);
+        for (int i = 0; i < n; i++) admitParcel(batch[i]);
+        commands.end();
+        wal.commit();
+    }
+
+    void releaseParcelId(int id) { parcelIds.release(id); }
+    bool claimParcelId(int id) { return parcelIds.claim(id); }
+
+    string trackSummary(int id) {
+        lock_guard<mutex> lock(engineMutex);
+        Parcel* p = trackingSystem.search(id);
+        Parcel* loaded = p ? nullptr : cold.load(id);
+        if (loaded) p = loaded;
+        if (!p) return "ERR parcel " + to_string(id) + " not found";
+        ostringstream out;
+        out << "OK " << p->id << " | " << p->statusText() << " | " << p->sourceCity() << " -> " << p->destCity()
+            << " | " << p->assignedRiderName() << " | PKR " << fixed << setprecision(2) << p->shippingCost();
+        delete loaded;
+        return out.str();
+    }
+
+    string statsSummary() {
+        lock_guard<mutex> lock(engineMutex);
+        ostringstream out;
+        out << "OK registered=" << stats.totalRegistered
+            << " pickup=" << stats.byStatus[ST_PICKUP]
+            << " warehouse=" << stats.byStatus[ST_WAREHOUSE]
+            << " transit=" << stats.byStatus[ST_IN_TRANSIT]
+            << " delivered=" << stats.byStatus[ST_DELIVERED]
+            << " revenuePKR=" << fixed << setprecision(2) << stats.revenuePaisa / 100.0;
+        return out.str();
+    }
+
+    // Checks every parcel in transit once against the current network and flags
+    // those whose route now crosses a blocked road. Parcels on the same city pair
+    // share one route query. Returns how many were newly flagged.
+    int reassessTransit() {
+        signed char verdict[MAX_CITIES * MAX_CITIES];   // -1 unknown, 0 clear, 1 blocked
+        memset(verdict, -1, sizeof(verdict));
+        int flagged = 0;
+        for (ParcelNode* curr = transitList.head; curr; curr = curr->next) {
+            Parcel* p = curr->data;
+            if (p->willFailOnPath) continue;
+            signed char& v = verdict[p->sourceCityID * MAX_CITIES + p->destCityID];
+            if (v < 0) {
+                if (!routingEngine.openlyConnected(p->sourceCityID, p->destCityID)) {
+                    v = 1;   // Every route crosses a block: no search needed
+                } else {
+                    PathInfo check = routingEngine.calculateShortestPath(p->sourceCityID, p->destCityID);
+                    v = (!check.isValid || check.isBlocked) ? 1 : 0;
+                }
+            }
+            if (v == 0) continue;
+            p->willFailOnPath = true;
+            wal.markDirty(p);
+            if (++flagged <= 20) cout << RED << " >> ALERT: Parcel #" << p->id << " is now on a blocked path!" << RESET << endl;
+        }
+        if (flagged > 20) cout << RED << " >> ... and " << (flagged - 20) << " more parcels on blocked paths." << RESET << endl;
+        return flagged;
+    }
+
+    // Publishes road updates as one network version, logs them and re-checks the
+    // parcels in transit once. Records nothing for undo. Caller holds engineMutex
+    // and commits the WAL.
+    int publishRoadBatch(RoadUpdate* updates, int n, int& flagged) {
+        flagged = 0;
+        int applied = routingEngine.applyRoadUpdates(updates, n);
+        if (applied == 0) return 0;
+        for (int i = 0; i < n; i++) {
+            if (updates[i].applied) wal.logRoad(updates[i].u, updates[i].v, updates[i].status, updates[i].factor);
+        }
+        flagged = reassessTransit();
+        return applied;
+    }
+
+    // Applies road updates as one network version, one undo transaction, one WAL
+    // commit and one impact pass, however many roads change. Caller holds engineMutex.
+    int applyRoadBatch(RoadUpdate* updates, int n, TransactionKind kind, int& flagged) {
+        int applied = publishRoadBatch(updates, n, flagged);
+        if (applied == 0) return 0;
+        commands.begin(kind, kind == TXN_ROAD_UPDATE ? updates[0].u * MAX_CITIES + updates[0].v : applied);
+        for (int i = 0; i < n; i++) {
+            RoadUpdate& r = updates[i];
+            if (r.applied) commands.record(CMD_ROAD, r.u * MAX_CITIES + r.v, r.beforeFactor, r.beforeStatus);
+        }
+        commands.end();
+        wal.commit();
+        return applied;
+    }
+
+    // Undoes a road transaction as it was applied: one network version holding
+    // every revert (newest change first), then one pass over the parcels in transit
+    int revertRoadBatch(const Transaction& t, int& skipped) {
+        int n = (int)(t.endSeq - t.firstSeq);
+        RoadUpdate* batch = new RoadUpdate[n > 0 ? n : 1];
+        for (int i = 0; i < n; i++) {
+            const Command& c = commands.at(t.endSeq - 1 - i);
+            batch[i] = RoadUpdate(c.target / MAX_CITIES, c.target % MAX_CITIES, c.before);
+            if (c.arg > 0) batch[i].factor = c.arg;
+        }
+        int flagged = 0;
+        int reverted = publishRoadBatch(batch, n, flagged);
+        delete[] batch;
+        skipped = n - reverted;
+        return reverted;
+    }
+
+    // Server feed: records separated by ';', e.g. "3 4 x2.5; 7 9 3; 1 2 1"
+    string applyTrafficFeed(const string& text) {
+        RoadUpdate* batch = new RoadUpdate[TRAFFIC_FEED_MAX_RECORDS];
+        int n = 0, bad = 0;
+        size_t start = 0;
+        while (start <= text.size()) {
+            size_t end = text.find(';', start);
+            if (end == string::npos) end = text.size();
+            string record = text.substr(start, end - start);
+            if (record.find_first_not_of(" \t\r") != string::npos) {
+                if (n < TRAFFIC_FEED_MAX_RECORDS && RoadUpdate::parse(record, batch[n])) n++;
+                else bad++;
+            }
+            start = end + 1;
+        }
+        int applied = 0, flagged = 0;
+        if (n > 0) {
+            lock_guard<mutex> lock(engineMutex);
+            applied = applyRoadBatch(batch, n, TXN_TRAFFIC_FEED, flagged);
+        }
+        delete[] batch;
+        return "OK applied=" + to_string(applied) + " rejected=" + to_string(n - applied + bad) +
+               " flagged=" + to_string(flagged) + " version=" + to_string(routingEngine.networkVersion());
+    }
+
+    // Admin: reads a feed file (one record per line, '#' starts a comment)
+    void ingestTrafficFile() {
+        UIHelper::printHeader("APPLY TRAFFIC FEED");
+        cout << " Format per line: <u> <v> <1|2|3>  or  <u> <v> x<multiplier>  (e.g. 4 7 x1.8)" << endl;
+        string path = UIHelper::getStringInput(" >> Feed file path (0 to Cancel): ");
+        if (path == "0") return;
+        FILE* f = fopen(path.c_str(), "r");
+        if (!f) {
+            cout << RED << " [!] Cannot open " << path << ": " << strerror(errno) << RESET << endl;
+            UIHelper::pressEnterToContinue();
+            return;
+        }
+
+        RoadUpdate* batch = new RoadUpdate[TRAFFIC_FEED_MAX_RECORDS];
+        int n = 0, bad = 0, lineNo = 0;
+        char line[256];
+        while (fgets(line, sizeof(line), f)) {
+            lineNo++;
+            char* hash = strchr(line, '#');
+            if (hash) *hash = '\0';
+            string record(line);
+            if (record.find_first_not_of(" \t\r\n") == string::npos) continue;
+            if (n >= TRAFFIC_FEED_MAX_RECORDS) {
+                cout << YELLOW << " >> Feed truncated at " << TRAFFIC_FEED_MAX_RECORDS << " records." << RESET << endl;
+                break;
+            }
+            if (RoadUpdate::parse(record, batch[n])) n++;
+            else if (++bad <= 10) cout << RED << " [!] Line " << lineNo << " ignored: bad record." << RESET << endl;
+        }
+        fclose(f);
+
+        int flagged = 0;
+        auto startT = chrono::steady_clock::now();
+        int applied = 0;
+        if (n > 0) {
+            lock_guard<mutex> lock(engineMutex);
+            applied = applyRoadBatch(batch, n, TXN_TRAFFIC_FEED, flagged);
+        }
+        long long ms = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - startT).count();
+        for (int i = 0, shown = 0; i < n && shown < 10; i++) {
+            if (batch[i].applied) continue;
+            cout << RED << " [!] Road " << batch[i].u << " - " << batch[i].v << " rejected: " << ROAD_REJECT_REASONS[batch[i].reject] << "." << RESET << endl;
+            shown++;
+        }
+        delete[] batch;
+
+        cout << GREEN << " >> " << applied << " of " << (n + bad) << " records applied as network version "
+             << routingEngine.networkVersion() << " (" << ms << " ms). " << flagged << " transit parcels flagged." << RESET << endl;
+        UIHelper::pressEnterToContinue();
+    }
+
+    // Admin: fastest route and travel time for each departure hour of today
+    void planByDepartureHour() {
+        routingEngine.printGraphTable();
+        int u = UIHelper::getIntInput(" >> Source City ID (0 to Cancel): ", 0, 100);
+        if (u == 0) return;
+        int v = UIHelper::getIntInput(" >> Dest City ID (0 to Cancel):   ", 0, 100);
+        if (v == 0) return;
+        if (routingEngine.getCityName(u) == "Unknown" || routingEngine.getCityName(v) == "Unknown") {
+            cout << RED << " [!] Invalid City IDs." << RESET << endl;
+            UIHelper::pressEnterToContinue();
+            return;
+        }
+
+        UIHelper::printHeader("DEPARTURE PLANNER: " + routingEngine.getCityName(u) + " -> " + routingEngine.getCityName(v));
+        cout << BLUE << " | " << setw(6) << "DEPART" << " | " << setw(50) << "FASTEST ROUTE" << " | " << setw(6) << "KM"
+             << " | " << setw(8) << "TIME(s)" << " |" << RESET << endl;
+        UIHelper::printLine();
+        time_t now = ClockService::now();
+        tm day;
+        localtime_r(&now, &day);
+        int quickest = INT_MAX, slowest = 0;
+        for (int hour = 0; hour < 24; hour++) {
+            tm at = day;
+            at.tm_hour = hour;
+            at.tm_min = 0;
+            at.tm_sec = 0;
+            PathInfo route = routingEngine.calculateFastestPath(u, v, mktime(&at));
+            if (!route.isValid) {
+                cout << RED << " [!] No path exists between these cities." << RESET << endl;
+                break;
+            }
+            quickest = min(quickest, route.travelSec);
+            slowest = max(slowest, route.travelSec);
+            char label[8];
+            snprintf(label, sizeof(label), "%02d:00", hour);
+            cout << " | " << setw(6) << label << " | " << setw(50) << route.pathDescription.substr(0, 50) << " | " << setw(6) << route.totalDist
+                 << " | " << (route.travelSec > quickest ? YELLOW : GREEN) << setw(8) << route.travelSec << RESET << " |" << endl;
+        }
+        UIHelper::printLine();
+        if (slowest > 0) cout << " Rush-hour spread: " << quickest << "s to " << slowest << "s." << endl;
+        cout << " " << routingEngine.travelProfileCount() << " travel profiles (" << routingEngine.travelProfilePoints()
+             << " breakpoints) shared across the road network." << endl;
+        UIHelper::pressEnterToContinue();
+    }
+
+    // Admin: runs every city pair through each search mode and checks they agree
+    void benchmarkRouting() {
+        UIHelper::printHeader("ROUTING ENGINE BENCHMARK (ALL CITY PAIRS)");
+        const RouteSearchMode modes[] = {ROUTE_DIJKSTRA, ROUTE_BIDIRECTIONAL, ROUTE_ASTAR};
+        const string modeNames[] = {"Dijkstra (early stop)", "Bidirectional Dijkstra", "A* + landmarks"};
+        const int modeCount = 3;
+
+        int cityCount = 0;
+        int ids[MAX_CITIES];
+        for (int c = 0; c < MAX_CITIES; c++) {
+            if (routingEngine.getCityName(c) != "Unknown") ids[cityCount++] = c;
+        }
+
+        int reference[MAX_CITIES][MAX_CITIES];
+        cout << BLUE << " | " << setw(22) << "MODE" << " | " << setw(8) << "PAIRS" << " | " << setw(14) << "SETTLED/QUERY"
+             << " | " << setw(10) << "US/QUERY" << " | " << setw(9) << "AGREES" << " |" << RESET << endl;
+        UIHelper::printLine();
+        for (int m = 0; m < modeCount; m++) {
+            long long settled = 0, pairs = 0, mismatches = 0;
+            auto startT = chrono::steady_clock::now();
+            for (int a = 0; a < cityCount; a++) {
+                for (int b = 0; b < cityCount; b++) {
+                    if (a == b) continue;
+                    PathInfo r = routingEngine.calculateShortestPath(ids[a], ids[b], modes[m]);
+                    settled += r.settledNodes;
+                    pairs++;
+                    if (m == 0) reference[a][b] = r.totalDist;
+                    else if (reference[a][b] != r.totalDist) mismatches++;
+                }
+            }
+            double us = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - startT).count();
+            cout << " | " << setw(22) << modeNames[m] << " | " << setw(8) << pairs << " | " << setw(14) << fixed << setprecision(2)
+                 << (pairs ? (double)settled / pairs : 0) << " | " << setw(10) << (pairs ? us / pairs : 0) << " | "
+                 << (mismatches ? RED : GREEN) << setw(9) << (mismatches ? to_string(mismatches) + " diff" : string("yes")) << RESET << " |" << endl;
+        }
+        {
+            // The same pairs as one many-to-many table (one sweep per source, or none if cached)
+            auto startT = chrono::steady_clock::now();
+            DistanceTable table(cityCount, cityCount);
+            routingEngine.fillDistanceTable(ids, ids, table);
+            double us = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - startT).count();
+            long long pairs = 0, mismatches = 0;
+            for (int a = 0; a < cityCount; a++) {
+                for (int b = 0; b < cityCount; b++) {
+                    if (a == b) continue;
+                    pairs++;
+                    if (table.at(a, b) != reference[a][b]) mismatches++;
+                }
+            }
+            cout << " | " << setw(22) << "Distance table" << " | " << setw(8) << pairs << " | " << setw(14) << "-"
+                 << " | " << setw(10) << (pairs ? us / pairs : 0) << " | "
+                 << (mismatches ? RED : GREEN) << setw(9) << (mismatches ? to_string(mismatches) + " diff" : string("yes")) << RESET << " |" << endl;
+        }
+        UIHelper::printLine();
+        cout << " " << routingEngine.landmarksInUse() << " landmarks over " << cityCount << " cities (base-distance tables, valid under any traffic)." << endl;
+        UIHelper::pressEnterToContinue();
+    }
+
+    // Admin: every city to every city on the current network, from one table
+    void viewDistanceMatrix() {
+        int cityCount = 0;
+        int ids[MAX_CITIES];
+        for (int c = 0; c < MAX_CITIES; c++) {
+            if (routingEngine.getCityName(c) != "Unknown") ids[cityCount++] = c;
+        }
+        DistanceTable table(cityCount, cityCount);
+        routingEngine.fillDistanceTable(ids, ids, table);
+
+        UIHelper::printHeader("CITY DISTANCE MATRIX (km, NETWORK VERSION " + to_string(table.version) + ")");
+        cout << BLUE << " " << setw(6) << "FROM";
+        for (int j = 0; j < cityCount; j++) cout << " " << setw(6) << routingEngine.getCityName(ids[j]).substr(0, 6);
+        cout << RESET << endl;
+        UIHelper::printLine();
+        for (int i = 0; i < cityCount; i++) {
+            cout << " " << setw(6) << routingEngine.getCityName(ids[i]).substr(0, 6);
+            for (int j = 0; j < cityCount; j++) {
+                int d = table.at(i, j);
+                cout << " " << setw(6) << (d == INT_MAX ? string("--") : to_string(d));
+            }
+            cout << endl;
+        }
+        UIHelper::printLine();
+        long long sweeps = 0, hits = 0;
+        routingEngine.distanceCacheStats(sweeps, hits);
+        cout << " Row cache: " << sweeps << " sweeps, " << hits << " rows reused since start-up." << endl;
+        UIHelper::pressEnterToContinue();
+    }
+
+    void processPickupQueue() {
+        UIHelper::printHeader("PROCESS PICKUP QUEUE");
+        unique_lock<mutex> lock(engineMutex);
+        if (pickupQueue.isEmpty()) {
+            lock.unlock();
+            cout << YELLOW << " >> Pickup Queue is empty. No parcels to process." << RESET << endl;
+            UIHelper::pressEnterToContinue();
+            return;
+        }
+
+        commands.begin(TXN_PICKUP_RUN, pickupQueue.count());
+        while (!pickupQueue.isEmpty()) {
+            Parcel* p = pickupQueue.dequeue();
+            p->pickupNode = nullptr;
+            setParcelStatus(p, ST_WAREHOUSE);
+            noteEvent(p, EV_WAREHOUSE_SORTED);
+            warehouseQueue.insert(p); 
+            commands.record(CMD_PICKUP, p->id);
+            wal.commitIfFull();
+            cout << " >> Processed ID #" << p->id << " (" << p->getPriorityStr() << ") -> Moved to Warehouse." << endl;
+        }
+        commands.end();
+        wal.commit();
+        lock.unlock();
+        cout << GREEN << " >> All items moved to Warehouse Heap." << RESET << endl;
+        UIHelper::pressEnterToContinue();
+    }
+
+    // Appends a history event and keeps the lastUpdateTime column in step with it
+    void noteEvent(Parcel* p, ParcelEventCode code, unsigned short arg = 0) {
+        p->addToHistory(code, arg);
+        columns.touch(p);
+    }
+
+    // Every parcel status change goes through here so derived views stay in step
+    void setParcelStatus(Parcel* p, ParcelStatusCode newCode) {
+        int oldCode = p->status;
+        time_t now = ClockService::now();
+        p->status = newCode;
+        p->lastUpdateTime = toParcelTime(now);
+        if (p->columnSlot >= 0) {
+            stats.onStatusChange(p, oldCode, newCode, (p->indexedRider >= 0 && p->indexedRider < fleetSize) ? fleet[p->indexedRider] : nullptr);
+            if (newCode == ST_DELIVERED && oldCode != ST_DELIVERED) rollups.recordDelivery(p, now);
+        }
+        columns.sync(p);
+        indexes.onStatusChange(p);
+        wal.markDirty(p);
+    }
+
+    // Greedy rider selection shared by manual and automatic dispatch.
+    // Strategy: Priority for Empty Riders to balance load ("Assign to another rider"),
+    // then fit into a busy rider (Capacity Optimization).
+    Rider* findRiderFor(Parcel* p, bool& wasIdle) {
+        for(int i=0; i<fleetSize; i++) {
+            if (fleet[i]->status == "Idle" && fleet[i]->canCarry(p->weight())) {
+                wasIdle = true;
+                return fleet[i];
+            }
+        }
+        for(int i=0; i<fleetSize; i++) {
+            if (fleet[i]->canCarry(p->weight())) {
+                wasIdle = false;
+                return fleet[i];
+            }
+        }
+        return nullptr;
+    }
+
+    // Most weight any single rider can still take on
+    double largestFreeCapacity() const {
+        double best = 0;
+        for (int i = 0; i < fleetSize; i++) {
+            best = max(best, fleet[i]->maxLoadCapacity - fleet[i]->currentLoad);
+        }
+        return best;
+    }
+
+    void assignToRider(Parcel* p, Rider* r) {
+        r->assignParcel(p->weight());
+
+        p->dispatchTime = toParcelTime(ClockService::now());
+        setParcelStatus(p, ST_IN_TRANSIT);
+        p->assignedRider = r;
+        p->riderNameId = r->nameId;
+        indexes.setRider(p, r->fleetIndex);
+        noteEvent(p, EV_DISPATCHED, r->nameId);
+
+        p->transitNode = transitList.pushBack(p);
+        commands.record(CMD_DISPATCH, p->id, r->fleetIndex);
+    }
+
+    void leaveTransit(Parcel* p) {
+        if (p->transitNode) {
+            transitList.removeNode(p->transitNode);
+            p->transitNode = nullptr;
+        }
+    }
 
-        cout << GREEN << " >> Success: Parcel Registered and placed in Pickup Queue." << RESET << endl;
-        cout << " >> Estimated Duration: " << newP->estimatedDurationSec << " seconds" << endl;
-        UIHelper::pressEnterToContinue();
+    // Gives the parcel's weight back to its rider when it leaves the transit flow
+    void releaseRider(Parcel* p) {
+        if (p->assignedRider) {
+            p->assignedRider->releaseParcel(p->weight());
+            p->assignedRider = nullptr;
+        }
     }
 
-    void processPickupQueue() {
-        UIHelper::printHeader("PROCESS PICKUP QUEUE");
-        if (pickupQueue.isEmpty()) {
-            cout << YELLOW << " >> Pickup Queue is empty. No parcels to process." << RESET << endl;
-            UIHelper::pressEnterToContinue();
-            return;
+    // Rolling re-dispatch: sends up to maxBatch warehouse parcels (by priority) onto
+    // capacity that has just been freed. Parcels flagged for a blocked route are left
+    // for manual dispatch so they do not bounce between road and warehouse. Parcels
+    // too heavy for every rider are set aside the same way, so lighter ones behind
+    // them still go out; the wave ends once no rider has any capacity left.
+    int runAutoDispatchWave(int maxBatch, ParcelEventCode historyNote) {
+        int dispatchedCount = 0;
+        ParcelStack tempStack;
+        double room = largestFreeCapacity();
+
+        commands.begin(TXN_AUTO_WAVE);
+        while (!warehouseQueue.isEmpty() && dispatchedCount < maxBatch && room > 0) {
+            Parcel* p = warehouseQueue.extractMin();
+            if (p->willFailOnPath || p->weight() > room) {
+                tempStack.push(p);
+                continue;
+            }
+            bool wasIdle = false;
+            Rider* r = findRiderFor(p, wasIdle);
+            if (!r) {
+                tempStack.push(p);
+                continue;
+            }
+            assignToRider(p, r);
+            noteEvent(p, historyNote);
+            dispatchedCount++;
+            room = largestFreeCapacity();
+            wal.commitIfFull();
         }
 
-        while (!pickupQueue.isEmpty()) {
-            Parcel* p = pickupQueue.dequeue();
-            p->status = p->sourceCity + " Warehouse";
-            p->addToHistory("Processed from Pickup Queue. Moved to " + p->sourceCity + " Warehouse Sorting.");
-            warehouseQueue.insert(p); 
-            cout << " >> Processed ID #" << p->id << " (" << p->getPriorityStr() << ") -> Moved to Warehouse." << endl;
+        while (!tempStack.isEmpty()) {
+            warehouseQueue.insert(tempStack.pop());
         }
-        cout << GREEN << " >> All items moved to Warehouse Heap." << RESET << endl;
-        UIHelper::pressEnterToContinue();
+        commands.setDetail(dispatchedCount);
+        commands.end();
+        return dispatchedCount;
     }
 
     void dispatchFromWarehouse() {
         UIHelper::printHeader("WAREHOUSE DISPATCH (RIDER ASSIGNMENT)");
         
+        unique_lock<mutex> lock(engineMutex);
         if (warehouseQueue.isEmpty()) {
             cout << YELLOW << " >> Warehouse is empty. Nothing to dispatch." << RESET << endl;
             // CHECK IF ITEMS ARE STUCK IN PICKUP
             if(!pickupQueue.isEmpty()) {
                 cout << RED << " [!] ALERT: " << pickupQueue.count() << " parcels are waiting in Pickup Queue. Please run 'Process Pickup Queue' first." << RESET << endl;
             }
+            lock.unlock();
             UIHelper::pressEnterToContinue();
             return;
         }
@@ -1112,61 +5829,23 @@ public:
 
         // Visual confirmation of Priority Processing
         cout << BOLD << " >> Processing Parcels by Priority (High -> Med -> Low)..." << RESET << endl;
+        commands.begin(TXN_MANUAL_DISPATCH);
 
         while(!warehouseQueue.isEmpty()) {
             Parcel* p = warehouseQueue.extractMin(); 
-            bool assigned = false;
-
-            // Strategy: Priority for Empty Riders to balance load ("Assign to another rider")
-            
-            // 1. Try to find an IDLE rider first
-            for(int i=0; i<fleetSize; i++) {
-                if (fleet[i]->status == "Idle" && fleet[i]->canCarry(p->weight)) {
-                    fleet[i]->assignParcel(p->weight);
-                    
-                    p->status = "In Transit";
-                    p->dispatchTime = time(0);
-                    p->lastUpdateTime = time(0);
-                    p->assignedRiderName = fleet[i]->name;
-                    p->addToHistory("Dispatched: Assigned to " + fleet[i]->name);
-                    
-                    transitList.pushBack(p);
-                    ActionLog log = {"DISPATCH", p, fleet[i]};
-                    undoStack.push(log);
-                    
-                    cout << GREEN << " >> [PRIORITY: " << p->getPriorityStr() << "] Parcel #" << p->id << " assigned to " << fleet[i]->name << " (New Assignment)" << RESET << endl;
-                    assigned = true;
-                    dispatchedCount++;
-                    break;
-                }
-            }
-
-            // 2. If no idle rider found, try to fit in a busy rider (Capacity Optimization)
-            if (!assigned) {
-                for(int i=0; i<fleetSize; i++) {
-                    if (fleet[i]->canCarry(p->weight)) {
-                        fleet[i]->assignParcel(p->weight);
-                        
-                        p->status = "In Transit";
-                        p->dispatchTime = time(0);
-                        p->lastUpdateTime = time(0);
-                        p->assignedRiderName = fleet[i]->name;
-                        p->addToHistory("Dispatched: Assigned to " + fleet[i]->name);
-                        
-                        transitList.pushBack(p);
-                        ActionLog log = {"DISPATCH", p, fleet[i]};
-                        undoStack.push(log);
-                        
-                        cout << YELLOW << " >> [PRIORITY: " << p->getPriorityStr() << "] Parcel #" << p->id << " added to " << fleet[i]->name << " (Load Optimization)" << RESET << endl;
-                        assigned = true;
-                        dispatchedCount++;
-                        break;
-                    }
-                }
-            }
-
-            if (!assigned) {
-                cout << RED << " >> [PRIORITY: " << p->getPriorityStr() << "] Parcel #" << p->id << " (" << p->weight << "kg) - NO RIDER CAPACITY. Returning to Storage." << RESET << endl;
+            bool wasIdle = false;
+            Rider* r = findRiderFor(p, wasIdle);
+
+            if (r) {
+                assignToRider(p, r);
+                if (wasIdle)
+                    cout << GREEN << " >> [PRIORITY: " << p->getPriorityStr() << "] Parcel #" << p->id << " assigned to " << r->name << " (New Assignment)" << RESET << endl;
+                else
+                    cout << YELLOW << " >> [PRIORITY: " << p->getPriorityStr() << "] Parcel #" << p->id << " added to " << r->name << " (Load Optimization)" << RESET << endl;
+                dispatchedCount++;
+                wal.commitIfFull();
+            } else {
+                cout << RED << " >> [PRIORITY: " << p->getPriorityStr() << "] Parcel #" << p->id << " (" << p->weight() << "kg) - NO RIDER CAPACITY. Returning to Storage." << RESET << endl;
                 tempStack.push(p);
             }
         }
@@ -1174,6 +5853,10 @@ public:
         while(!tempStack.isEmpty()) {
             warehouseQueue.insert(tempStack.pop());
         }
+        if (dispatchedCount > 0) commands.setDetail(dispatchedCount);
+        commands.end();
+        wal.commit();
+        lock.unlock();
 
         cout << endl << CYAN << " >> Dispatch Complete. Total Dispatched: " << dispatchedCount << RESET << endl;
         UIHelper::pressEnterToContinue();
@@ -1181,95 +5864,214 @@ public:
 
     void undoLastOp() {
         UIHelper::printHeader("UNDO OPERATIONS LOG");
-        if (undoStack.isEmpty()) {
+        unique_lock<mutex> lock(engineMutex);
+        if (commands.isEmpty()) {
+            lock.unlock();
             cout << RED << " >> No operations to undo." << RESET << endl;
             UIHelper::pressEnterToContinue();
             return;
         }
 
-        ActionLog last = undoStack.pop();
-        if (last.actionType == "DISPATCH") {
-            Parcel* p = last.parcelPtr;
-            Rider* r = last.riderPtr;
-            
-            if (transitList.remove(p)) {
-                p->status = p->sourceCity + " Warehouse";
-                p->assignedRiderName = "None";
-                p->addToHistory("UNDO: Dispatch reversed. Returned to Warehouse.");
+        cout << BLUE << " | " << setw(8) << "TIME" << " | " << setw(20) << "TRANSACTION" << " | " << setw(26) << "DETAIL" << " | " << setw(8) << "COMMANDS" << " |" << RESET << endl;
+        UIHelper::printLine();
+        for (int i = 0; i < commands.transactions() && i < 10; i++) {
+            Transaction& t = commands.recent(i);
+            cout << " | " << setw(8) << ClockService::timeStr(t.openedAt) << " | " << setw(20) << TRANSACTION_NAMES[t.kind]
+                 << " | " << setw(26) << describeTransaction(t).substr(0, 26) << " | " << setw(8) << t.endSeq - t.firstSeq << " |"
+                 << (i == 0 ? (YELLOW + "  <- next undo" + RESET) : "") << endl;
+        }
+        UIHelper::printLine();
+        cout << " Log holds " << commands.transactions() << " transactions / " << commands.commandsHeld()
+             << " commands (ring of " << COMMAND_LOG_CAPACITY << ")." << endl;
+        if (commands.oversizedDropped() > 0) {
+            cout << RED << " [!] " << commands.oversizedDropped() << " transaction(s) outgrew the ring and cannot be undone." << RESET << endl;
+        }
+        long long shownSeq = commands.recent(0).firstSeq;
+        lock.unlock();
+
+        int confirm = UIHelper::getIntInput(" >> Enter 1 to Undo the Latest Transaction (0 to Return): ", 0, 1);
+        if (confirm == 0) return;
+
+        lock.lock();
+        // The scheduler may have logged a wave while the prompt was open
+        if (commands.isEmpty() || commands.recent(0).firstSeq != shownSeq) {
+            lock.unlock();
+            cout << YELLOW << " >> The log changed while waiting (an auto-dispatch wave ran). Nothing was undone." << RESET << endl;
+            UIHelper::pressEnterToContinue();
+            return;
+        }
+
+        // Newest command first, so each one sees the state it produced
+        Transaction t = commands.popLatest();
+        int reverted = 0, skipped = 0;
+        if (t.kind == TXN_ROAD_UPDATE || t.kind == TXN_TRAFFIC_FEED) {
+            reverted = revertRoadBatch(t, skipped);
+        } else {
+            for (long long seq = t.endSeq - 1; seq >= t.firstSeq; seq--) {
+                if (revertCommand(commands.at(seq))) reverted++;
+                else skipped++;
+                wal.commitIfFull();
+            }
+        }
+        wal.commit();
+        lock.unlock();
+
+        cout << YELLOW << " >> UNDO COMPLETE: " << TRANSACTION_NAMES[t.kind] << " reverted (" << reverted << " commands)." << RESET << endl;
+        if (skipped > 0) {
+            cout << RED << " >> " << skipped << " commands skipped: their parcels have moved on (delivered, missing or archived)." << RESET << endl;
+        }
+        UIHelper::pressEnterToContinue();
+    }
+
+    string describeTransaction(Transaction& t) {
+        switch (t.kind) {
+            case TXN_REGISTER:        return "Parcel #" + to_string(t.detail);
+            case TXN_PICKUP_RUN:      return to_string(t.detail) + " parcels to warehouse";
+            case TXN_MANUAL_DISPATCH:
+            case TXN_AUTO_WAVE:       return to_string(t.detail) + " parcels dispatched";
+            case TXN_ROAD_UPDATE:     return routingEngine.getCityName(t.detail / MAX_CITIES) + " - " + routingEngine.getCityName(t.detail % MAX_CITIES);
+            case TXN_COUNTER_BATCH:   return to_string(t.detail) + " parcels from counters";
+            case TXN_TRAFFIC_FEED:    return to_string(t.detail) + " road records";
+        }
+        return "";
+    }
+
+    // Reverts one parcel command if the state it produced is still in place
+    // (road commands are reverted as a batch by revertRoadBatch)
+    bool revertCommand(const Command& c) {
+        Parcel* p = trackingSystem.search(c.target);
+        if (!p) return false;
+        switch (c.type) {
+            case CMD_REGISTER:
+                // Only a parcel still waiting for pickup can be taken back
+                if (p->status != ST_PICKUP || !p->pickupNode) return false;
+                pickupQueue.removeNode(p->pickupNode);
+                p->pickupNode = nullptr;
+                stats.onUnregister(p);
+                parcelIds.release(p->id);
+                rollups.cancelBooking(p->sourceCityID, p->destCityID, fromParcelTime(p->creationTime));
+                if (p->walPending) wal.commit();
+                wal.logDrop(p->id);
+                evictParcel(p);
+                return true;
+
+            case CMD_PICKUP:
+                if (p->status != ST_WAREHOUSE || !warehouseQueue.remove(p)) return false;
+                setParcelStatus(p, ST_PICKUP);
+                noteEvent(p, EV_UNDO_PICKUP);
+                // Reverse order + push to front restores the original queue order
+                p->pickupNode = pickupQueue.requeueFront(p);
+                return true;
+
+            case CMD_DISPATCH: {
+                if (p->status != ST_IN_TRANSIT || !p->transitNode) return false;
+                Rider* r = (c.arg >= 0 && c.arg < fleetSize) ? fleet[c.arg] : nullptr;
+                leaveTransit(p);
                 p->dispatchTime = 0;
-                
-                r->currentLoad -= p->weight;
-                if (r->currentLoad == 0) r->status = "Idle";
-                
+                setParcelStatus(p, ST_WAREHOUSE);
+                p->riderNameId = 0;
+                indexes.setRider(p, -1);
+                noteEvent(p, EV_UNDO_DISPATCH);
+                if (r && p->assignedRider == r) releaseRider(p);
                 warehouseQueue.insert(p);
-                cout << YELLOW << " >> UNDO SUCCESS: Parcel #" << p->id << " removed from " << r->name << " and returned to Warehouse." << RESET << endl;
-            } else {
-                cout << RED << " >> UNDO FAILED: Parcel not found in transit (maybe already delivered?)" << RESET << endl;
+                return true;
             }
         }
-        UIHelper::pressEnterToContinue();
+        return false;
     }
 
+    // The scheduler thread raises these; menus print them between prompts
+    void queueAlert(const string& line) {
+        if (pendingAlertCount < SIM_ALERT_BACKLOG) pendingAlerts += line + "\n";
+        pendingAlertCount++;
+    }
+
+    // Caller holds engineMutex; prints nothing so it can run inside the lock
+    string takeAlerts() {
+        string out;
+        out.swap(pendingAlerts);
+        if (pendingAlertCount > SIM_ALERT_BACKLOG) {
+            out += string(RED) + " >> ... and " + to_string(pendingAlertCount - SIM_ALERT_BACKLOG) + " more alerts." + RESET + "\n";
+        }
+        pendingAlertCount = 0;
+        return out;
+    }
+
+    // Runs on the scheduler thread under engineMutex, so parcels keep moving
+    // with nobody at a terminal. Alerts are queued, never written to cout.
     void updateSimulation() {
-        time_t now = time(0);
+        time_t now = ClockService::now();
         ParcelNode* curr = transitList.head;
-        ParcelList toRemove; 
+        bool capacityFreed = false;
 
         while (curr) {
+            wal.commitIfFull(); // Every parcel before this one is fully processed
             Parcel* p = curr->data;
-            double secondsElapsed = difftime(now, p->dispatchTime);
-            double timeSinceLastUpdate = difftime(now, p->lastUpdateTime);
+            ParcelNode* next = curr->next; // curr may be unlinked below
+            double secondsElapsed = difftime(now, fromParcelTime(p->dispatchTime));
+            double timeSinceLastUpdate = difftime(now, fromParcelTime(p->lastUpdateTime));
 
             // 1. MISSING LOGIC (Inactive/Stagnant for 300s)
             // If status hasn't changed for 300s, declare MISSING and REMOVE from active flow
-            if (timeSinceLastUpdate > MISSING_PARCEL_THRESHOLD && p->status == "In Transit") {
-                p->status = "MISSING";
-                p->addToHistory("ALERT: Parcel declared MISSING due to inactivity.");
-                cout << RED << " >> ALERT: Parcel #" << p->id << " status hasn't changed for 300s. Declared MISSING." << RESET << endl;
+            if (timeSinceLastUpdate > MISSING_PARCEL_THRESHOLD && p->status == ST_IN_TRANSIT) {
+                setParcelStatus(p, ST_MISSING);
+                noteEvent(p, EV_MISSING);
+                queueAlert(string(RED) + " >> ALERT: Parcel #" + to_string(p->id) + " status hasn't changed for 300s. Declared MISSING." + RESET);
                 
                 // Remove from transit list (active flow). 
                 // It stays in masterList for the "Missing Report".
-                toRemove.pushBack(p); 
-                curr = curr->next;
+                releaseRider(p);
+                leaveTransit(p);
+                capacityFreed = true;
+                curr = next;
                 continue; 
             }
 
             // 2. FAILED DELIVERY LOGIC (Blocked Road)
-            else if (p->willFailOnPath && !p->isReturning && p->status == "In Transit") {
+            else if (p->willFailOnPath && !p->isReturning && p->status == ST_IN_TRANSIT) {
                 // Simulate reaching the block point or destination time
                 if (secondsElapsed > (p->estimatedDurationSec * 0.2)) {
-                    p->status = p->sourceCity + " Warehouse"; // Reset to source
-                    p->addToHistory("FAILURE: Route Blocked. Returned to Source Warehouse.");
-                    cout << RED << " >> Delivery Failed for Parcel #" << p->id << " due to blockage. Returned to " << p->sourceCity << " Warehouse." << RESET << endl;
+                    setParcelStatus(p, ST_WAREHOUSE); // Reset to source
+                    noteEvent(p, EV_ROUTE_BLOCKED_RETURN);
+                    queueAlert(string(RED) + " >> Delivery Failed for Parcel #" + to_string(p->id) + " due to blockage. Returned to " + p->sourceCity() + " Warehouse." + RESET);
                     
                     // Return to Warehouse (System retains it)
+                    releaseRider(p);
+                    leaveTransit(p); // Remove from transit list only
+                    capacityFreed = true;
                     warehouseQueue.insert(p);
-                    toRemove.pushBack(p); // Remove from transit list only
                 }
             }
 
             // 3. SUCCESSFUL DELIVERY
             else if (secondsElapsed >= p->estimatedDurationSec) {
-                 if (p->status == "Returning") {
-                    p->status = "Returned to Sender";
-                    p->addToHistory("Process Complete: Item returned to sender.");
+                 p->completionTime = toParcelTime(now);
+                 if (p->status == ST_RETURNING) {
+                    setParcelStatus(p, ST_RETURNED);
+                    noteEvent(p, EV_RETURNED);
                  } else {
-                    p->status = "Delivered";
-                    p->addToHistory("Process Complete: Successfully Delivered.");
+                    setParcelStatus(p, ST_DELIVERED);
+                    noteEvent(p, EV_DELIVERED);
                  }
                  
-                 p->addToHistory("Archived: Moved to Historical Record.");
+                 noteEvent(p, EV_ARCHIVED);
+                 releaseRider(p);
+                 leaveTransit(p);
+                 capacityFreed = true;
                  archive.insert(p);
-                 toRemove.pushBack(p);
             }
             
-            curr = curr->next;
+            curr = next;
         }
 
-        // Cleanup transit list
-        while (!toRemove.isEmpty()) {
-            transitList.remove(toRemove.popFront());
+        // Next wave goes out as soon as riders come back with free capacity
+        if (capacityFreed && !warehouseQueue.isEmpty()) {
+            int sent = runAutoDispatchWave(AUTO_DISPATCH_BATCH_SIZE, EV_AUTO_DISPATCH_FREED);
+            if (sent > 0) {
+                queueAlert(string(CYAN) + " >> AUTO-DISPATCH: " + to_string(sent) + " parcel(s) sent out on freed rider capacity." + RESET);
+            }
         }
+        wal.commit();
     }
 
     void trackParcel() {
@@ -1277,19 +6079,34 @@ public:
         int id = UIHelper::getIntInput(" >> Enter Parcel ID (0 to Cancel): ", 0, 99999);
         if (id == 0) return;
         
-        Parcel* p = trackingSystem.search(id);
-        
-        if (p) {
-            p->displayFullDetails();
-        } else {
-            cout << RED << " >> Error: Parcel ID not found in the system." << RESET << endl;
+        {
+            lock_guard<mutex> lock(engineMutex);
+            Parcel* p = trackingSystem.search(id);
+
+            if (p) {
+                p->displayFullDetails();
+            } else if ((p = cold.load(id)) != nullptr) {
+                p->displayFullDetails();
+                delete p;
+            } else {
+                cout << RED << " >> Error: Parcel ID not found in the system." << RESET << endl;
+            }
         }
         UIHelper::pressEnterToContinue();
     }
 
+    // Filtered views walk only their own index list
     void viewAllParcels(string filter = "ALL") {
-        UIHelper::printHeader("SHIPMENT LIST (" + filter + ")");
+        if (filter == "TRANSIT") viewParcelList("TRANSIT", indexes.withStatus(ST_IN_TRANSIT));
+        else if (filter == "WAREHOUSE") viewParcelList("WAREHOUSE", indexes.withStatus(ST_WAREHOUSE));
+        else viewParcelList("ALL", masterList);
+    }
+
+    void viewParcelList(string title, ParcelList& list) {
+        UIHelper::printHeader("SHIPMENT LIST (" + title + ")");
+        unique_lock<mutex> lock(engineMutex);
         if (masterList.isEmpty()) {
+            lock.unlock();
             cout << YELLOW << " >> No parcels in the system." << RESET << endl;
             UIHelper::pressEnterToContinue();
             return;
@@ -1305,27 +6122,142 @@ public:
              << " | " << RESET << endl;
         UIHelper::printLine();
         
-        ParcelNode* curr = masterList.head;
-        int count = 0;
+        ParcelNode* curr = list.head;
         while(curr) {
-            bool show = false;
-            if (filter == "ALL") show = true;
-            else if (filter == "TRANSIT" && curr->data->status == "In Transit") show = true;
-            else if (filter == "WAREHOUSE" && curr->data->status.find("Warehouse") != string::npos) show = true;
-            
-            if (show) {
-                curr->data->displayTableRow();
-                count++;
-            }
+            curr->data->displayTableRow();
             curr = curr->next;
         }
-        if (count == 0) cout << YELLOW << "    No parcels found matching this filter." << RESET << endl;
+        if (list.isEmpty()) cout << YELLOW << "    No parcels found matching this filter." << RESET << endl;
+        lock.unlock();
         UIHelper::printLine();
         UIHelper::pressEnterToContinue();
     }
 
+    // Admin drill-down over the master list or one of the secondary indexes
+    void viewFilteredParcels() {
+        UIHelper::printHeader("MASTER SHIPMENT LIST");
+        UIHelper::printMenuOption(1, "All Parcels");
+        UIHelper::printMenuOption(2, "By Status");
+        UIHelper::printMenuOption(3, "By Source City");
+        UIHelper::printMenuOption(4, "By Destination City");
+        UIHelper::printMenuOption(5, "By Rider");
+        UIHelper::printMenuOption(0, "Back");
+        int mode = UIHelper::getIntInput(" >> Select Filter: ", 0, 5);
+        if (mode == 0) return;
+        if (mode == 1) { viewParcelList("ALL", masterList); return; }
+
+        if (mode == 2) {
+            for (int k = 0; k < ST_COUNT; k++) UIHelper::printMenuOption(k + 1, STATUS_CODE_NAMES[k]);
+            int k = UIHelper::getIntInput(" >> Select Status: ", 1, ST_COUNT) - 1;
+            viewParcelList("STATUS: " + STATUS_CODE_NAMES[k], indexes.withStatus(k));
+        } else if (mode == 3 || mode == 4) {
+            routingEngine.printGraphTable();
+            int c = UIHelper::getIntInput(" >> City ID: ", 1, MAX_CITIES - 1);
+            if (routingEngine.getCityName(c) == "Unknown") {
+                cout << RED << " [!] Invalid City ID." << RESET << endl;
+                UIHelper::pressEnterToContinue();
+                return;
+            }
+            if (mode == 3) viewParcelList("FROM " + routingEngine.getCityName(c), indexes.fromCity(c));
+            else viewParcelList("TO " + routingEngine.getCityName(c), indexes.toCity(c));
+        } else {
+            for (int i = 0; i < fleetSize; i++) UIHelper::printMenuOption(i + 1, fleet[i]->name);
+            int r = UIHelper::getIntInput(" >> Select Rider: ", 1, fleetSize) - 1;
+            viewParcelList("RIDER: " + fleet[r]->name, indexes.withRider(r));
+        }
+    }
+
+    // Paginated browser over the archive. Scans start at a key and stop at an
+    // upper bound, so only the rows on screen are ever touched. Each page holds
+    // engineMutex only while it is read and resumes from the last key shown:
+    // a cold flush may free the archive's nodes while the prompt is open.
+    void viewArchive() {
+        UIHelper::printSubHeader("DELIVERED HISTORY (ARCHIVE)");
+        unique_lock<mutex> lock(engineMutex);
+        if (archive.isEmpty() && cold.size() == 0) {
+            lock.unlock();
+            cout << YELLOW << "    (History Archive is Empty)" << RESET << endl;
+            UIHelper::pressEnterToContinue();
+            return;
+        }
+        cout << " Archived Parcels: " << archive.size() + cold.size() << " (" << cold.size() << " in cold storage)" << endl;
+        lock.unlock();
+        UIHelper::printMenuOption(1, "Browse by Parcel ID");
+        UIHelper::printMenuOption(2, "Browse by Delivery Time (Oldest First)");
+        UIHelper::printMenuOption(3, "Parcel ID Range");
+        UIHelper::printMenuOption(4, "Delivered in the Last N Minutes");
+        UIHelper::printMenuOption(0, "Back");
+        int mode = UIHelper::getIntInput(" >> Select View: ", 0, 4);
+        if (mode == 0) return;
+
+        bool byTime = (mode == 2 || mode == 4);
+        long long upper = LLONG_MAX;
+        ArchiveKey resume = {0, INT_MIN};  // First key not shown yet: parcel ID, or completion time + ID
+        if (mode == 3) {
+            int lo = UIHelper::getIntInput(" >> From Parcel ID: ", 0, 99999);
+            int hi = UIHelper::getIntInput(" >> To Parcel ID:   ", lo, 99999);
+            resume.major = lo;
+            upper = hi;
+        } else if (mode == 4) {
+            int minutes = UIHelper::getIntInput(" >> Minutes to look back: ", 1, 525600);
+            resume.major = ClockService::now() - minutes * 60;
+        }
+
+        Parcel row(0);
+        int page = 1;
+        while (true) {
+            lock.lock();
+            // Cold rows are always older than the in-memory archive, so a time walk
+            // reads them first; an ID walk merges the two sources.
+            ArchiveCursor cursor = byTime ? archive.seekTime((time_t)resume.major, resume.id) : archive.seekId((int)resume.major);
+            long long coldRow = byTime ? cold.firstRowCompletedAt((time_t)resume.major) : cold.size();
+            int coldId = byTime ? -1 : cold.nextIdAtLeast((int)resume.major);
+
+            UIHelper::printSubHeader("ARCHIVE PAGE " + to_string(page) + (byTime ? " (BY DELIVERY TIME)" : " (BY PARCEL ID)"));
+            archive.printTableHeader();
+            int shown = 0;
+            bool more = true;
+            while (shown < ARCHIVE_PAGE_SIZE) {
+                Parcel* hot = (cursor.isValid() && cursor.key().major <= upper) ? cursor.value() : nullptr;
+                bool fromCold = byTime ? coldRow < cold.size()
+                                       : (coldId >= 0 && coldId <= upper && (!hot || coldId < hot->id));
+                Parcel* next;
+                if (fromCold) {
+                    cold.readSummary(byTime ? coldRow++ : cold.findRow(coldId), row);
+                    if (!byTime) coldId = cold.nextIdAtLeast(coldId + 1);
+                    else if (archiveKeyLess(ArchiveKey{(long long)fromParcelTime(row.completionTime), row.id}, resume)) continue;
+                    next = &row;
+                } else if (hot) {
+                    next = hot;
+                    cursor.advance();
+                } else {
+                    more = false;
+                    break;
+                }
+                next->displayTableRow();
+                resume = byTime ? ArchiveKey{(long long)fromParcelTime(next->completionTime), next->id + 1}
+                                : ArchiveKey{(long long)next->id + 1, INT_MIN};
+                shown++;
+            }
+            if (shown == 0) cout << YELLOW << "    No archived parcels in this range." << RESET << endl;
+            UIHelper::printLine();
+
+            if (more) {
+                more = (cursor.isValid() && cursor.key().major <= upper) ||
+                       (byTime ? coldRow < cold.size() : (coldId >= 0 && coldId <= upper));
+            }
+            lock.unlock();
+            if (!more) break;
+            int next = UIHelper::getIntInput(" >> [1] Next Page  [0] Back: ", 0, 1);
+            if (next == 0) return;
+            page++;
+        }
+        UIHelper::pressEnterToContinue();
+    }
+
     void viewHighPriorityQueue() {
         UIHelper::printHeader("HIGH PRIORITY QUEUE VIEW");
+        unique_lock<mutex> lock(engineMutex);
         if (warehouseQueue.isEmpty()) {
              cout << YELLOW << " >> Warehouse is empty." << RESET << endl;
         } else {
@@ -1336,10 +6268,11 @@ public:
              for(int i=0; i<warehouseQueue.size() && i<10; i++) {
                   Parcel* p = warehouseQueue.getAtIndex(i); 
                   if(p) {
-                      cout << " | " << setw(5) << p->id << " | " << setw(5) << p->getPriorityStr() << " | " << setw(6) << p->weight << " |" << endl;
+                      cout << " | " << setw(5) << p->id << " | " << setw(5) << p->getPriorityStr() << " | " << setw(6) << p->weight() << " |" << endl;
                   }
              }
         }
+        lock.unlock();
         UIHelper::pressEnterToContinue();
     }
 
@@ -1355,54 +6288,242 @@ public:
              << " |" << RESET << endl;
         UIHelper::printLine();
         
-        for(int i=0; i<fleetSize; i++) {
-            fleet[i]->displayRow();
+        {
+            lock_guard<mutex> lock(engineMutex);
+            for(int i=0; i<fleetSize; i++) {
+                fleet[i]->displayRow();
+            }
         }
         UIHelper::printLine();
         UIHelper::pressEnterToContinue();
     }
 
+    // O(1): reads the running counters only, safe for dashboards to poll
     void viewAnalytics() {
         UIHelper::printHeader("SYSTEM ANALYTICS REPORT");
-        int total = masterList.size;
-        int delivered = 0;
-        int failed = 0;
-        int transit = 0;
-        double revenue = 0.0;
+        unique_lock<mutex> lock(engineMutex);
+        long long failed = stats.byStatus[ST_RETURNED] + stats.byStatus[ST_FAILED];
 
-        ParcelNode* curr = masterList.head;
-        while(curr) {
-            if(curr->data->status == "Delivered") { delivered++; revenue += curr->data->shippingCost; }
-            else if(curr->data->status == "Returned to Sender" || curr->data->status == "Delivery Failed") failed++;
-            else if(curr->data->status == "In Transit") transit++;
-            curr = curr->next;
+        cout << " Total Parcels Registered: " << BOLD << stats.totalRegistered << RESET << endl;
+        cout << " Successfully Delivered:   " << GREEN << stats.byStatus[ST_DELIVERED] << RESET << endl;
+        cout << " Failed / Returned:        " << RED << failed << RESET << endl;
+        cout << " Currently In Transit:     " << BLUE << stats.byStatus[ST_IN_TRANSIT] << RESET << endl;
+        cout << " Total Revenue Generated:  " << YELLOW << "PKR " << fixed << setprecision(2) << stats.revenuePaisa / 100.0 << RESET << endl;
+
+        UIHelper::printSubHeader("PER-RIDER TOTALS");
+        cout << BLUE << " | " << setw(15) << "RIDER" << " | " << setw(8) << "ON BOARD" << " | " << setw(9) << "DELIVERED" << " | " << setw(12) << "KG DELIVERED" << " |" << RESET << endl;
+        UIHelper::printLine();
+        for (int i = 0; i < fleetSize; i++) {
+            cout << " | " << setw(15) << fleet[i]->name
+                 << " | " << setw(8) << fleet[i]->activeParcels
+                 << " | " << setw(9) << fleet[i]->deliveredCount
+                 << " | " << setw(12) << setprecision(1) << fleet[i]->deliveredKg << " |" << endl;
         }
+        UIHelper::printLine();
 
-        cout << " Total Parcels Registered: " << BOLD << total << RESET << endl;
-        cout << " Successfully Delivered:   " << GREEN << delivered << RESET << endl;
-        cout << " Failed / Returned:        " << RED << failed << RESET << endl;
-        cout << " Currently In Transit:     " << BLUE << transit << RESET << endl;
-        cout << " Total Revenue Generated:  " << YELLOW << "PKR " << fixed << setprecision(2) << revenue << RESET << endl;
+        UIHelper::printSubHeader("PER-CITY TOTALS");
+        cout << BLUE << " | " << setw(15) << "CITY" << " | " << setw(10) << "SENT FROM" << " | " << setw(12) << "DELIVERED TO" << " | " << setw(16) << "REVENUE (PKR)" << " |" << RESET << endl;
+        UIHelper::printLine();
+        for (int c = 0; c < routingEngine.getCityCount(); c++) {
+            if (stats.cityRegistered[c] == 0 && stats.cityDelivered[c] == 0) continue;
+            cout << " | " << setw(15) << routingEngine.getCityName(c)
+                 << " | " << setw(10) << stats.cityRegistered[c]
+                 << " | " << setw(12) << stats.cityDelivered[c]
+                 << " | " << setw(16) << setprecision(2) << stats.cityRevenuePaisa[c] / 100.0 << " |" << endl;
+        }
+        lock.unlock();
+        UIHelper::printLine();
         
         UIHelper::pressEnterToContinue();
     }
+
+    // Reads only the buckets inside the requested window
+    void viewRollups() {
+        UIHelper::printHeader("CITY-PAIR REVENUE & THROUGHPUT ROLLUPS");
+        routingEngine.printGraphTable();
+        int src = UIHelper::getIntInput(" >> Source City ID (0 to Cancel): ", 0, MAX_CITIES - 1);
+        if (src == 0) return;
+        int dst = UIHelper::getIntInput(" >> Destination City ID (0 to Cancel): ", 0, MAX_CITIES - 1);
+        if (dst == 0) return;
+        if (routingEngine.getCityName(src) == "Unknown" || routingEngine.getCityName(dst) == "Unknown") {
+            cout << RED << " [!] Invalid City IDs." << RESET << endl;
+            UIHelper::pressEnterToContinue();
+            return;
+        }
+        UIHelper::printMenuOption(1, "Hourly - Last 24 Hours");
+        UIHelper::printMenuOption(2, "Hourly - Last 7 Days");
+        UIHelper::printMenuOption(3, "Daily - Last 30 Days");
+        int mode = UIHelper::getIntInput(" >> Select Window: ", 1, 3);
+
+        time_t now = ClockService::now();
+        bool hourly = (mode != 3);
+        int periods = (mode == 1) ? 24 : (mode == 2 ? ROLLUP_HOURS : 30);
+        long long last = hourly ? rollups.currentHour(now) : rollups.currentDay(now);
+
+        UIHelper::printSubHeader(routingEngine.getCityName(src) + " -> " + routingEngine.getCityName(dst));
+        cout << BLUE << " | " << setw(16) << (hourly ? "HOUR STARTING" : "DAY") << " | " << setw(7) << "BOOKED"
+             << " | " << setw(9) << "DELIVERED" << " | " << setw(10) << "KG" << " | " << setw(14) << "REVENUE (PKR)"
+             << " | " << setw(11) << "AVG LAT(s)" << " |" << RESET << endl;
+        UIHelper::printLine();
+
+        RollupBucket total;
+        total.clear(0);
+        int activePeriods = 0;
+        unique_lock<mutex> lock(engineMutex);
+        for (long long period = last - periods + 1; period <= last; period++) {
+            RollupBucket b = hourly ? rollups.hourTotal(src, dst, period, now) : rollups.dayTotal(src, dst, period, now);
+            if (b.booked == 0 && b.delivered == 0) continue;
+            total.add(b);
+            activePeriods++;
+            time_t start = hourly ? rollups.hourStart(period) : rollups.dayStart(period);
+            char label[32];
+            strftime(label, sizeof(label), hourly ? "%d %b %H:00" : "%d %b %Y", localtime(&start));
+            cout << " | " << setw(16) << label << " | " << setw(7) << b.booked
+                 << " | " << setw(9) << b.delivered << " | " << setw(10) << fixed << setprecision(1) << b.grams / 1000.0
+                 << " | " << setw(14) << setprecision(2) << b.revenuePaisa / 100.0
+                 << " | " << setw(11) << (b.delivered ? b.latencySec / b.delivered : 0) << " |" << endl;
+        }
+        lock.unlock();
+        if (activePeriods == 0) cout << YELLOW << "    No activity for this city pair in the selected window." << RESET << endl;
+        UIHelper::printLine();
+        cout << " Window Total: " << total.delivered << " delivered, PKR " << fixed << setprecision(2) << total.revenuePaisa / 100.0
+             << " (PKR " << total.revenuePaisa / 100.0 / periods << " per " << (hourly ? "hour" : "day") << ")" << endl;
+        UIHelper::pressEnterToContinue();
+    }
+
+    // Full columnar scan: billed amount and weight per status, cross-checked
+    // against the running counters
+    void viewStatusBreakdown() {
+        UIHelper::printHeader("STATUS BREAKDOWN AUDIT (FULL SCAN)");
+        long long counts[ST_COUNT], paisa[ST_COUNT], grams[ST_COUNT], running[ST_COUNT];
+        {
+            lock_guard<mutex> lock(engineMutex);
+            columns.aggregateByStatus(counts, paisa, grams);
+            cold.aggregateByStatus(counts, paisa, grams);
+            for (int k = 0; k < ST_COUNT; k++) running[k] = stats.byStatus[k];
+        }
+
+        cout << BLUE << " | " << setw(20) << "STATUS" << " | " << setw(10) << "PARCELS" << " | " << setw(16) << "BILLED (PKR)" << " | " << setw(12) << "WEIGHT (kg)" << " |" << RESET << endl;
+        UIHelper::printLine();
+        bool consistent = true;
+        for (int k = 0; k < ST_COUNT; k++) {
+            if (counts[k] != running[k]) consistent = false;
+            if (counts[k] == 0) continue;
+            cout << " | " << setw(20) << STATUS_CODE_NAMES[k]
+                 << " | " << setw(10) << counts[k]
+                 << " | " << setw(16) << fixed << setprecision(2) << paisa[k] / 100.0
+                 << " | " << setw(12) << setprecision(1) << grams[k] / 1000.0 << " |" << endl;
+        }
+        UIHelper::printLine();
+        if (consistent) cout << GREEN << " >> Running counters match the full scan." << RESET << endl;
+        else cout << RED << " [!] Running counters differ from the full scan." << RESET << endl;
+        UIHelper::pressEnterToContinue();
+    }
     
     void resetSystem() {
         UIHelper::printHeader("RESET SYSTEM SIMULATION");
         cout << RED << " Warning: This will clear all current transit data. (Parcels remain in record)" << RESET << endl;
         int confirm = UIHelper::getIntInput(" Enter 1 to Confirm Reset (0 to Cancel): ", 0, 1);
         if(confirm == 1) {
+            lock_guard<mutex> lock(engineMutex);
             for(int i=0; i<fleetSize; i++) fleet[i]->reset();
+            // Parcels still on the road no longer hold capacity on the reset riders
+            ParcelNode* curr = transitList.head;
+            while (curr) {
+                curr->data->assignedRider = nullptr;
+                wal.markDirty(curr->data);
+                curr = curr->next;
+            }
+            rebuildRiderTotals();
+            wal.commit();
             cout << GREEN << " >> Riders returned to base. Day reset." << RESET << endl;
         }
         UIHelper::pressEnterToContinue();
     }
     
+    void viewPersistence() {
+        UIHelper::printHeader("PERSISTENCE STATUS");
+        unique_lock<mutex> lock(engineMutex);
+        cout << " Write-Ahead Log:     " << WAL_PATH << (wal.isOpen() ? "" : (RED + "  [NOT WRITABLE]" + RESET)) << endl;
+        cout << " Log Generation:      " << wal.currentGeneration() << endl;
+        cout << " Log Size:            " << fixed << setprecision(2) << wal.size() / 1024.0 << " KB"
+             << " (snapshot at " << SNAPSHOT_WAL_BYTES / (1024 * 1024) << " MB)" << endl;
+        cout << " Group Commits:       " << wal.commits() << endl;
+        UIHelper::printLine();
+        cout << " Snapshot File:       " << SNAPSHOT_PATH << endl;
+        cout << " Snapshots Taken:     " << checkpointCount << endl;
+        if (lastCheckpointAt != 0) {
+            cout << " Last Snapshot:       " << ClockService::timeStr(lastCheckpointAt) << " (" << lastCheckpointParcels << " parcels)" << endl;
+        }
+        cout << " Startup Recovery:    " << recoveredParcels << " parcels from " << recoveredRecords
+             << " records in " << recoveryMs << " ms" << endl;
+        UIHelper::printLine();
+        cout << " Cold Tier:           " << COLD_ROWS_PATH << (cold.isOpen() ? "" : (RED + "  [NOT WRITABLE]" + RESET))
+             << (cold.dictionaryFull() ? (RED + "  [DICTIONARY FULL]" + RESET) : "") << endl;
+        cout << " Cold Parcels:        " << cold.size() << " (" << cold.eventCount() << " history events)" << endl;
+        cout << " Mapped Size:         " << fixed << setprecision(2) << cold.bytesOnDisk() / (1024.0 * 1024.0) << " MB" << endl;
+        cout << " Flushes This Run:    " << coldFlushCount << " (next at " << COLD_FLUSH_MIN_PARCELS
+             << " archived parcels or every " << COLD_FLUSH_INTERVAL_SEC / 60 << " min)" << endl;
+        cout << " Archive In Memory:   " << archive.size() << " parcels" << endl;
+        lock.unlock();
+        UIHelper::printLine();
+        UIHelper::printMenuOption(1, "Take a Snapshot Now");
+        UIHelper::printMenuOption(2, "Move Archived Parcels to Cold Tier Now");
+        UIHelper::printMenuOption(0, "Return");
+        int choice = UIHelper::getIntInput(" >> Select Option: ", 0, 2);
+        if (choice == 1) {
+            lock.lock();
+            if (snapshotInFlight) cout << YELLOW << " >> A snapshot is already being written. Try again in a moment." << RESET << endl;
+            else if (checkpoint(lock)) cout << GREEN << " >> Snapshot written. Log restarted at generation " << wal.currentGeneration() << "." << RESET << endl;
+            else cout << RED << " [!] Snapshot failed. The existing snapshot and log are unchanged." << RESET << endl;
+            lock.unlock();
+            UIHelper::pressEnterToContinue();
+        } else if (choice == 2) {
+            lock.lock();
+            long long before = cold.size();
+            if (coldFlushInFlight) cout << YELLOW << " >> A cold-tier flush is already running. Try again in a moment." << RESET << endl;
+            else if (flushColdTier(lock)) cout << GREEN << " >> " << cold.size() - before << " parcels moved to the cold tier." << RESET << endl;
+            else if (archive.isEmpty()) cout << YELLOW << " >> The in-memory archive is empty." << RESET << endl;
+            else if (cold.dictionaryFull()) cout << RED << " [!] Cold tier name/route dictionary is full. Parcels remain in memory." << RESET << endl;
+            else cout << RED << " [!] Cold tier write failed. Parcels remain in memory." << RESET << endl;
+            lock.unlock();
+            UIHelper::pressEnterToContinue();
+        }
+    }
+
+    void configureScheduler() {
+        UIHelper::printHeader("AUTO-DISPATCH SCHEDULER SETTINGS");
+        {
+            lock_guard<mutex> lock(engineMutex);
+            cout << " Current Fill Threshold:  " << fillThreshold << " parcels per city warehouse" << endl;
+            cout << " Current Batching Window: " << batchWindowSec << " seconds" << endl;
+            cout << " Waves Run So Far:        " << autoWaveCount << " (" << autoDispatchedCount << " parcels dispatched)" << endl;
+        }
+        UIHelper::printLine();
+        int threshold = UIHelper::getIntInput(" >> New Fill Threshold (1-500, 0 to Cancel): ", 0, 500);
+        if (threshold == 0) return;
+        int window = UIHelper::getIntInput(" >> New Batching Window in seconds (1-3600): ", 1, 3600);
+        {
+            lock_guard<mutex> lock(engineMutex);
+            fillThreshold = threshold;
+            batchWindowSec = window;
+            wal.logScheduler(fillThreshold, batchWindowSec);
+            wal.commit();
+        }
+        cout << GREEN << " >> Scheduler updated. A wave runs at " << threshold << " parcels or after " << window << "s, whichever comes first." << RESET << endl;
+        UIHelper::pressEnterToContinue();
+    }
+
     void adminControls() {
         while(true) {
-            updateSimulation();
+            string alerts;
+            {
+                lock_guard<mutex> lock(engineMutex);
+                alerts = takeAlerts();
+            }
             UIHelper::clearScreen();
             UIHelper::printHeader("ADMINISTRATION PANEL");
+            cout << alerts;
             UIHelper::printMenuOption(1, "View Network Map (Road Status)");
             UIHelper::printMenuOption(2, "Update Road Status (Traffic/Block)");
             UIHelper::printMenuOption(3, "View Missing/Stuck Parcels Report");
@@ -1411,13 +6532,22 @@ public:
             UIHelper::printMenuOption(6, "View Master Shipment List (All Parcels)");
             UIHelper::printMenuOption(7, "View System Analytics & Revenue");
             UIHelper::printMenuOption(8, "Reset Daily Simulation (End Day)");
+            UIHelper::printMenuOption(9, "Configure Auto-Dispatch Scheduler");
+            UIHelper::printMenuOption(10, "Status Breakdown Audit (Full Scan)");
+            UIHelper::printMenuOption(11, "City-Pair Revenue & Throughput Rollups");
+            UIHelper::printMenuOption(12, "Persistence Status (Log, Snapshots & Cold Tier)");
+            UIHelper::printMenuOption(13, "Apply Traffic Feed (Batch File)");
+            UIHelper::printMenuOption(14, "Departure Planner (Rush-Hour Travel Times)");
+            UIHelper::printMenuOption(15, "Routing Engine Benchmark (Search Modes)");
+            UIHelper::printMenuOption(16, "City Distance Matrix (Many-to-Many)");
             UIHelper::printMenuOption(0, "Log Out");
             UIHelper::printLine();
             
-            int choice = UIHelper::getIntInput(" >> Select Option: ", 0, 8);
+            int choice = UIHelper::getIntInput(" >> Select Option: ", 0, 16);
             
             if (choice == 0) break;
             
+            // Each screen takes engineMutex only while it touches the engine, never across a prompt
             switch(choice) {
                 case 1: 
                     routingEngine.printGraphTable(); 
@@ -1433,22 +6563,14 @@ public:
                     if(routingEngine.getCityName(u) != "Unknown" && routingEngine.getCityName(v) != "Unknown") {
                         cout << " [1] Normal\n [2] Heavy Traffic\n [3] Blocked" << endl;
                         int s = UIHelper::getIntInput(" >> New Status: ", 1, 3);
-                        bool updated = routingEngine.setRoadStatus(u, v, s);
-                        
-                        if (updated) {
+                        RoadUpdate update(u, v, s);
+                        int flagged = 0, applied;
+                        {
+                            lock_guard<mutex> lock(engineMutex);
+                            applied = applyRoadBatch(&update, 1, TXN_ROAD_UPDATE, flagged);
+                        }
+                        if (applied == 1) {
                             cout << GREEN << " >> Road Status Updated Successfully." << RESET << endl;
-                            ParcelNode* curr = transitList.head;
-                            while(curr) {
-                                Parcel* p = curr->data;
-                                int pu = routingEngine.getCityID(p->sourceCity);
-                                int pv = routingEngine.getCityID(p->destCity);
-                                PathInfo check = routingEngine.calculateShortestPath(pu, pv);
-                                if (!check.isValid) {
-                                    p->willFailOnPath = true;
-                                    cout << RED << " >> ALERT: Parcel #" << p->id << " is now on a blocked path!" << RESET << endl;
-                                }
-                                curr = curr->next;
-                            }
                         } else {
                             cout << RED << " [!] Error: No direct road exists between these two cities." << RESET << endl;
                         }
@@ -1460,42 +6582,66 @@ public:
                 }
                 case 3: {
                     UIHelper::printSubHeader("MISSING PARCEL REPORT");
-                    ParcelNode* curr = masterList.head;
+                    long long cutoff = (long long)ClockService::now() - MISSING_PARCEL_THRESHOLD;
                     bool found = false;
-                    while(curr) {
-                        if (curr->data->isMissing()) {
-                            curr->data->displayTableRow();
-                            found = true;
+                    // Only parcels still in the active flow can go missing
+                    const int activeStatuses[] = {ST_PICKUP, ST_WAREHOUSE, ST_IN_TRANSIT, ST_RETURNING};
+                    {
+                        lock_guard<mutex> lock(engineMutex);
+                        for (int a = 0; a < 4; a++) {
+                            ParcelNode* curr = indexes.withStatus(activeStatuses[a]).head;
+                            while (curr) {
+                                if (columns.isStale(curr->data->columnSlot, cutoff)) {
+                                    curr->data->displayTableRow();
+                                    found = true;
+                                }
+                                curr = curr->next;
+                            }
                         }
-                        curr = curr->next;
                     }
                     if (!found) cout << GREEN << " >> No missing parcels detected." << RESET << endl;
                     UIHelper::pressEnterToContinue();
                     break;
                 }
-                case 4: 
-                    UIHelper::printSubHeader("DELIVERED HISTORY (ARCHIVE)");
-                    archive.displayInOrder();
-                    UIHelper::pressEnterToContinue();
-                    break;
+                case 4: viewArchive(); break;
                 case 5: viewFleetStatus(); break;
-                case 6: viewAllParcels(); break;
+                case 6: viewFilteredParcels(); break;
                 case 7: viewAnalytics(); break;
                 case 8: resetSystem(); break;
+                case 9: configureScheduler(); break;
+                case 10: viewStatusBreakdown(); break;
+                case 11: viewRollups(); break;
+                case 12: viewPersistence(); break;
+                case 13: ingestTrafficFile(); break;
+                case 14: planByDepartureHour(); break;
+                case 15: benchmarkRouting(); break;
+                case 16: viewDistanceMatrix(); break;
             }
         }
     }
 
     void staffMenu() {
         while(true) {
-            updateSimulation(); 
+            int waves, autoSent, threshold, windowSec;
+            string alerts;
+            {
+                lock_guard<mutex> lock(engineMutex);
+                alerts = takeAlerts();
+                waves = autoWaveCount;
+                autoSent = autoDispatchedCount;
+                threshold = fillThreshold;
+                windowSec = batchWindowSec;
+            }
             UIHelper::clearScreen();
             UIHelper::printHeader("STAFF DASHBOARD");
+            cout << CYAN << " Auto-Dispatch: " << RESET << waves << " waves, " << autoSent
+                 << " parcels (at " << threshold << " per warehouse or every " << windowSec << "s)" << endl;
+            cout << alerts;
             UIHelper::printMenuOption(1, "Register New Parcel");
             UIHelper::printMenuOption(2, "Process Pickup Queue (-> Warehouse)");
             UIHelper::printMenuOption(3, "Dispatch Warehouse (-> Riders)");
             UIHelper::printMenuOption(4, "Track Parcel Details");
-            UIHelper::printMenuOption(5, "Undo Last Dispatch Operation");
+            UIHelper::printMenuOption(5, "Undo Last Operation (Whole Transaction)");
             UIHelper::printMenuOption(6, "View Queue Status (Pending/Warehouse)");
             UIHelper::printMenuOption(7, "View Active Shipments (In Transit)");
             UIHelper::printMenuOption(8, "View High Priority Parcels (Preview)");
@@ -1504,6 +6650,7 @@ public:
             
             int choice = UIHelper::getIntInput(" >> Select Option: ", 0, 8);
             
+            // Handlers lock engineMutex around their engine calls and release it before any prompt
             switch(choice) {
                 case 1: registerParcel(); break;
                 case 2: processPickupQueue(); break;
@@ -1512,6 +6659,7 @@ public:
                 case 5: undoLastOp(); break;
                 case 6: {
                     UIHelper::printSubHeader("1. PENDING (PICKUP QUEUE)");
+                    unique_lock<mutex> lock(engineMutex);
                     if (pickupQueue.isEmpty()) {
                         cout << YELLOW << " No parcels waiting for pickup." << RESET << endl;
                     } else {
@@ -1519,14 +6667,15 @@ public:
                         ParcelNode* curr = pickupQueue.getHead();
                         while(curr) {
                             cout << " | " << setw(5) << curr->data->id 
-                                 << " | " << setw(12) << curr->data->sourceCity.substr(0,12) 
-                                 << " | " << setw(12) << curr->data->destCity.substr(0,12) << " |" << endl;
+                                 << " | " << setw(12) << curr->data->sourceCity().substr(0,12) 
+                                 << " | " << setw(12) << curr->data->destCity().substr(0,12) << " |" << endl;
                             curr = curr->next;
                         }
                     }
                     cout << "\n ----------------------------- \n";
                     UIHelper::printSubHeader("2. WAREHOUSE SORTING QUEUE");
                     cout << " Warehouse Heap Count:  " << warehouseQueue.size() << endl;
+                    lock.unlock();
                     viewAllParcels("WAREHOUSE");
                     break;
                 }
@@ -1553,7 +6702,8 @@ public:
             int choice = UIHelper::getIntInput(" >> Select Role: ", 0, 2);
             
             if (choice == 0) {
-                cout << GREEN << " >> Shutting down system... Goodbye!" << RESET << endl;
+                cout << GREEN << " >> Saving snapshot and shutting down... Goodbye!" << RESET << endl;
+                shutdown();
                 exit(0);
             }
             
@@ -1584,11 +6734,362 @@ public:
 };
 
 // ==========================================
-// 7. ENTRY POINT
+// 7. SERVER MODE (MULTI-CLIENT COUNTERS)
+// ==========================================
+// "SwiftEx --server [socket] [shards]" serves counter terminals over a local
+// stream socket. One request per line, one reply line (OK ... / ERR ...):
+//   REGISTER <id> <srcCityID> <destCityID> <weightKg> <priority 1-3>
+//   TRACK <id>
+//   STATS
+//   TRAFFIC <u> <v> <1|2|3|xM> [; <u> <v> ...]   (one batch, one network version)
+//   QUIT
+//
+// Registrations are sharded by source city. Each shard owns a request queue and
+// a worker thread that does the expensive part of a booking (validation, routing,
+// pricing, history) outside engineMutex, then hands the priced parcel to the
+// lock-free pickup intake. One intake worker admits everything that has piled up
+// under a single engine lock and WAL group commit. IDs are claimed lock-free by
+// the connection thread before a request is queued, so shards never talk to each
+// other. TRACK and STATS are short reads and go straight to the engine.
+
+struct ServerRequest : MpscLink {
+    int id;
+    int srcID;
+    int destID;
+    double kg;
+    int priority;
+    Parcel* parcel;          // Priced by the shard, admitted by the intake worker
+    string result;           // Reply line sent once the parcel is durable
+    promise<string> reply;
+};
+
+// The single consumer of the pickup intake. Shards push priced requests without
+// ever taking engineMutex; this worker drains whatever has accumulated from all
+// shards into the engine under one lock and one WAL commit, then answers them.
+class PickupIntake {
+private:
+    SwiftExEngine* engine;
+    MpscQueue queue;
+    atomic<bool> sleeping;
+    atomic<bool> stopping;
+    mutex wakeMutex;
+    condition_variable wake;
+    thread worker;
+    atomic<long long> admitted;
+    atomic<long long> batches;
+
+    void run() {
+        ServerRequest* batch[SERVER_INTAKE_BATCH];
+        Parcel* parcels[SERVER_INTAKE_BATCH];
+        while (true) {
+            int n = 0;
+            MpscLink* link;
+            while (n < SERVER_INTAKE_BATCH && (link = queue.pop()) != nullptr) {
+                batch[n] = static_cast<ServerRequest*>(link);
+                parcels[n] = batch[n]->parcel;
+                n++;
+            }
+            if (n > 0) {
+                engine->admitBatch(parcels, n);
+                // The request lives on its connection thread, which may return as soon as it is answered
+                for (int i = 0; i < n; i++) batch[i]->reply.set_value(batch[i]->result);
+                admitted += n;
+                batches++;
+                continue;
+            }
+            if (stopping && queue.isEmpty()) break;
+
+            // Producers only touch the lock when they see this worker asleep
+            unique_lock<mutex> lock(wakeMutex);
+            sleeping = true;
+            if (queue.isEmpty()) wake.wait_for(lock, chrono::milliseconds(SERVER_POLL_MS));
+            sleeping = false;
+        }
+    }
+
+public:
+    PickupIntake(SwiftExEngine* e) : engine(e), sleeping(false), stopping(false), admitted(0), batches(0) {
+        worker = thread(&PickupIntake::run, this);
+    }
+
+    ~PickupIntake() { stop(); }
+
+    void push(ServerRequest* r) {
+        queue.push(r);
+        if (sleeping) {
+            lock_guard<mutex> lock(wakeMutex);
+            wake.notify_one();
+        }
+    }
+
+    // Call after every producer has stopped: drains the queue, then joins
+    void stop() {
+        stopping = true;
+        {
+            lock_guard<mutex> lock(wakeMutex);
+            wake.notify_one();
+        }
+        if (worker.joinable()) worker.join();
+    }
+
+    long long admittedCount() { return admitted; }
+    long long batchCount() { return batches; }
+};
+
+class RegistrationShard {
+private:
+    SwiftExEngine* engine;
+    PickupIntake* intake;
+    ServerRequest** queue;   // Ring of pending requests
+    int head;
+    int count;
+    bool stopping;
+    mutex queueMutex;
+    condition_variable queueReady;
+    condition_variable queueSpace;
+    thread worker;
+    atomic<long long> registered;
+
+    void run() {
+        ServerRequest* batch[SERVER_SHARD_BATCH];
+        while (true) {
+            int n = 0;
+            {
+                unique_lock<mutex> lock(queueMutex);
+                queueReady.wait(lock, [this] { return count > 0 || stopping; });
+                if (count == 0) break;   // Stopping and drained
+                while (count > 0 && n < SERVER_SHARD_BATCH) {
+                    batch[n++] = queue[head];
+                    head = (head + 1) % SERVER_SHARD_QUEUE;
+                    count--;
+                }
+            }
+            queueSpace.notify_all();
+
+            for (int i = 0; i < n; i++) {
+                ServerRequest* r = batch[i];
+                string error;
+                Parcel* p = engine->quoteRegistration(r->id, r->srcID, r->destID, r->kg, r->priority, error);
+                if (!p) {
+                    engine->releaseParcelId(r->id);
+                    r->reply.set_value("ERR " + error);
+                    continue;
+                }
+                ostringstream out;
+                out << "OK " << p->id << " PKR " << fixed << setprecision(2) << p->shippingCost()
+                    << " ETA " << p->estimatedDurationSec << "s ROUTE " << p->assignedRoute()
+                    << (p->willFailOnPath ? " [BLOCKED]" : "");
+                r->result = out.str();
+                r->parcel = p;
+                // Lock-free hand-off: the shard moves on without waiting for the commit
+                intake->push(r);
+                registered++;
+            }
+        }
+    }
+
+public:
+    RegistrationShard(SwiftExEngine* e, PickupIntake* in)
+        : engine(e), intake(in), queue(new ServerRequest*[SERVER_SHARD_QUEUE]), head(0), count(0), stopping(false),
+          registered(0) {
+        worker = thread(&RegistrationShard::run, this);
+    }
+
+    ~RegistrationShard() {
+        stop();
+        delete[] queue;
+    }
+
+    // Blocks while the shard is SERVER_SHARD_QUEUE requests behind (backpressure)
+    void submit(ServerRequest* r) {
+        {
+            unique_lock<mutex> lock(queueMutex);
+            queueSpace.wait(lock, [this] { return count < SERVER_SHARD_QUEUE; });
+            queue[(head + count) % SERVER_SHARD_QUEUE] = r;
+            count++;
+        }
+        queueReady.notify_one();
+    }
+
+    // Finishes everything already queued, then joins the worker
+    void stop() {
+        {
+            lock_guard<mutex> lock(queueMutex);
+            stopping = true;
+        }
+        queueReady.notify_all();
+        if (worker.joinable()) worker.join();
+    }
+
+    long long pricedCount() { return registered; }
+};
+
+class SwiftExServer {
+private:
+    SwiftExEngine& engine;
+    RegistrationShard* shards[MAX_SERVER_SHARDS];
+    PickupIntake* intake;
+    int shardCount;
+    int listenFd;
+    string socketPath;
+    atomic<int> activeClients;
+
+    // Read by every connection thread; a lock-free atomic is safe to set from a signal handler
+    static atomic<bool>& stopFlag() {
+        static atomic<bool> flag(false);
+        return flag;
+    }
+    static void onSignal(int) { stopFlag() = true; }
+
+    static bool sendLine(int fd, const string& line) {
+        string out = line + "\n";
+        size_t sent = 0;
+        while (sent < out.size()) {
+            ssize_t n = send(fd, out.data() + sent, out.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) return false;
+            sent += (size_t)n;
+        }
+        return true;
+    }
+
+    string handle(const string& line) {
+        istringstream in(line);
+        string cmd;
+        in >> cmd;
+        for (size_t i = 0; i < cmd.size(); i++) cmd[i] = (char)toupper((unsigned char)cmd[i]);
+
+        if (cmd == "REGISTER") {
+            ServerRequest r;
+            if (!(in >> r.id >> r.srcID >> r.destID >> r.kg >> r.priority)) {
+                return "ERR usage: REGISTER <id> <srcCityID> <destCityID> <weightKg> <priority 1-3>";
+            }
+            if (r.srcID < 0 || r.srcID >= MAX_CITIES) return "ERR unknown city";
+            if (!engine.claimParcelId(r.id)) return "ERR parcel ID " + to_string(r.id) + " is taken or outside 1-" + to_string(MAX_PARCEL_ID);
+            future<string> reply = r.reply.get_future();
+            shards[r.srcID % shardCount]->submit(&r);
+            return reply.get();
+        }
+        if (cmd == "TRACK") {
+            int id;
+            if (!(in >> id)) return "ERR usage: TRACK <id>";
+            return engine.trackSummary(id);
+        }
+        if (cmd == "STATS") {
+            return engine.statsSummary() + " shards=" + to_string(shardCount) + " commits=" + to_string(intake->batchCount());
+        }
+        if (cmd == "TRAFFIC") {
+            string records;
+            getline(in, records);
+            return engine.applyTrafficFeed(records);
+        }
+        return "ERR unknown command (REGISTER, TRACK, STATS, TRAFFIC, QUIT)";
+    }
+
+    void serveClient(int fd) {
+        string pending;
+        char buffer[4096];
+        bool open = true;
+        while (open && !stopFlag()) {
+            pollfd pfd = {fd, POLLIN, 0};
+            int ready = poll(&pfd, 1, SERVER_POLL_MS);
+            if (ready == 0) continue;
+            if (ready < 0) break;
+            ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+            if (n <= 0) break;
+            pending.append(buffer, (size_t)n);
+
+            size_t start = 0, end;
+            while ((end = pending.find('\n', start)) != string::npos) {
+                string line = pending.substr(start, end - start);
+                start = end + 1;
+                if (!line.empty() && line.back() == '\r') line.pop_back();
+                if (line.empty()) continue;
+                if (line == "QUIT" || line == "quit") {
+                    open = false;
+                    break;
+                }
+                if (!sendLine(fd, handle(line))) {
+                    open = false;
+                    break;
+                }
+            }
+            pending.erase(0, start);
+        }
+        ::close(fd);
+        activeClients--;
+    }
+
+public:
+    SwiftExServer(SwiftExEngine& e) : engine(e), intake(nullptr), shardCount(0), listenFd(-1), activeClients(0) {}
+
+    // Serves until SIGINT/SIGTERM, then drains the shards and snapshots the engine
+    bool run(const string& path, int requestedShards) {
+        shardCount = max(1, min(requestedShards, MAX_SERVER_SHARDS));
+        socketPath = path;
+
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(addr.sun_path)) {
+            cout << RED << " [!] Socket path is too long: " << path << RESET << endl;
+            return false;
+        }
+        strcpy(addr.sun_path, path.c_str());
+        listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+        unlink(path.c_str());
+        if (listenFd < 0 || bind(listenFd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(listenFd, 128) != 0) {
+            cout << RED << " [!] Could not listen on " << path << ": " << strerror(errno) << RESET << endl;
+            if (listenFd >= 0) ::close(listenFd);
+            return false;
+        }
+
+        signal(SIGINT, onSignal);
+        signal(SIGTERM, onSignal);
+        intake = new PickupIntake(&engine);
+        for (int i = 0; i < shardCount; i++) shards[i] = new RegistrationShard(&engine, intake);
+        cout << GREEN << " >> SwiftEx server listening on " << path << " with " << shardCount
+             << " registration shards. Ctrl+C to stop." << RESET << endl;
+
+        while (!stopFlag()) {
+            pollfd pfd = {listenFd, POLLIN, 0};
+            if (poll(&pfd, 1, SERVER_POLL_MS) <= 0) continue;
+            int fd = accept(listenFd, nullptr, nullptr);
+            if (fd < 0) continue;
+            activeClients++;
+            thread(&SwiftExServer::serveClient, this, fd).detach();
+        }
+
+        ::close(listenFd);
+        unlink(path.c_str());
+        // Clients notice the flag within one poll period; in-flight requests still complete
+        while (activeClients > 0) this_thread::sleep_for(chrono::milliseconds(SERVER_POLL_MS / 4));
+
+        // Producers first, then the consumer, so nothing is left in the intake
+        for (int i = 0; i < shardCount; i++) {
+            shards[i]->stop();
+            delete shards[i];
+        }
+        intake->stop();
+        long long total = intake->admittedCount();
+        delete intake;
+        cout << YELLOW << " >> Server stopped. " << total << " parcels registered this session." << RESET << endl;
+        engine.shutdown();
+        return true;
+    }
+};
+
+// ==========================================
+// 8. ENTRY POINT
 // ==========================================
-int main() {
+int main(int argc, char** argv) {
     srand(time(0));
     SwiftExEngine app;
+    if (argc > 1 && string(argv[1]) == "--server") {
+        string path = argc > 2 ? argv[2] : SERVER_SOCKET_PATH;
+        int shards = argc > 3 ? atoi(argv[3]) : (int)thread::hardware_concurrency();
+        SwiftExServer server(app);
+        return server.run(path, shards) ? 0 : 1;
+    }
     app.login();
     return 0;
-}
\ No newline at end of file
+}